@@ -1,6 +1,8 @@
 #include "Ast.hpp"
 
 #include "Lexer.hpp"
+#include "Library.hpp"
+#include "ThreadPool.hpp"
 #include "WrapperFunctions.hpp"
 
 namespace Interpreter {
@@ -96,7 +98,7 @@ void DotOperation::Print(std::ostream& os, size_t depth) const {
 
 VarID DotOperation::ReturnType(const SymbolTable* scope) const {
     const auto symbol = (scope ? *scope : Symbols())[attribute];
-    return chainedOperation ? chainedOperation->ReturnType(symbol.isFunction ? nullptr : &GetGlobal().GetObject(symbol.type).Symbols()) : symbol.type;
+    return chainedOperation ? chainedOperation->ReturnType(symbol.isFunction ? nullptr : &SymbolsOfType(scope ? *scope : Symbols(), attribute)) : symbol.type;
 }
 
 void DotOperation::SetType(VarID type) {
@@ -156,7 +158,22 @@ UnaryOperation::UnaryOperation(Node* parent, const Token& token, const std::func
 
     value = std::make_unique<Expression>(this, token, shift);
 
-    returnType = token.IsLogicalOperator() ? Symbols()["bool"].id : value->ReturnType();
+    if (operation == "yield") {
+        Node* node = parent;
+        while (node && !dynamic_cast<FunctionDef*>(node)) {
+            node = node->parent;
+        }
+        if (!node) {
+            throw InterpreterException("Yield outside of a function.", line);
+        }
+        static_cast<FunctionDef*>(node)->isGenerator = true;
+        returnType = Symbols()["void"].id;
+    } else if (operation == "spawn" || operation == "await") {
+        // Handle of a spawned call and result of an awaited one are known only once they run
+        returnType = Symbols()["any"].id;
+    } else {
+        returnType = token.IsLogicalOperator() ? Symbols()["bool"].id : value->ReturnType();
+    }
 }
 
 void UnaryOperation::Print(std::ostream& os, size_t depth) const {
@@ -255,7 +272,7 @@ void VariableRef::Print(std::ostream& os, size_t depth) const {
 
 VarID VariableRef::ReturnType(const SymbolTable* scope) const {
     const auto symbol = (scope ? *scope : Symbols())[name];
-    return chainedOperation ? chainedOperation->ReturnType(symbol.isFunction ? nullptr : &GetGlobal().GetObject(symbol.type).Symbols()) : symbol.type;
+    return chainedOperation ? chainedOperation->ReturnType(symbol.isFunction ? nullptr : &SymbolsOfType(scope ? *scope : Symbols(), name)) : symbol.type;
 }
 
 void VariableRef::SetType(VarID type) {
@@ -442,6 +459,10 @@ Arguments::Arguments(Node* parent, const Token& token, const std::function<void(
 
     lParenClose::RequireToken(token);
     shift();
+
+    for (const auto& argument : arguments) {
+        types.push_back(argument.ReturnType());
+    }
 }
 
 void Arguments::Print(std::ostream& os, size_t depth) const {
@@ -500,14 +521,17 @@ FunctionCall::FunctionCall(const SymbolTable& scope, const VarRef& identifier, N
                 throw TypeMismatchException(std::to_string(arguments.size()) + " arg(s)", std::to_string(functionDef.arguments->arguments.size()) + " arg(s)", line);
         }
 
+        // Types the body infers for arguments declared without one are known only once it is parsed
+        bool concurrent = GetGlobal().concurrent;
         auto anyType = Symbols()["any"].id;
         auto inIt = arguments.begin();
         auto argIt = functionDef.arguments->arguments.begin();
-        for (; inIt != arguments.end(); ++inIt, ++argIt) {
+        auto typeIt = functionDef.arguments->types.begin();
+        for (; inIt != arguments.end(); ++inIt, ++argIt, ++typeIt) {
             auto inType = inIt->ReturnType();
-            auto argType = argIt->ReturnType();
+            auto argType = concurrent ? *typeIt : argIt->ReturnType();
             if (inType != anyType && argType != anyType && inType != argType) {
-                throw TypeMismatchException(ToString(functionDef.Symbols()[argType]), ToString(Symbols()[inType]), line);
+                throw TypeMismatchException(ToString(Symbols()[argType]), ToString(Symbols()[inType]), line);
             }
         }
     }
@@ -809,6 +833,11 @@ VarID IfExpr::ReturnType(const SymbolTable* scope) const {
 
 ForExpr::ForExpr(Node* parent, const Token& token, const std::function<void()>& shift)
     : Node(parent, token.line), symbols(&parent->Symbols()) {
+    isParallel = lParallel::MatchToken(token);
+    if (isParallel) {
+        shift();
+    }
+
     lFor::RequireToken(token);
     shift();
 
@@ -827,6 +856,9 @@ ForExpr::ForExpr(Node* parent, const Token& token, const std::function<void()>&
 void ForExpr::Print(std::ostream& os, size_t depth) const {
     os << Indent(depth) << "\"For\": {\n";
     os << Indent(depth + 1) << "\"Symbols\": " << Symbols() << ",\n";
+    if (isParallel) {
+        os << Indent(depth + 1) << "\"Parallel\": true,\n";
+    }
     os << Indent(depth + 1) << "\"ControlVariable\": {\n";
     controlVariable ? controlVariable->Print(os, depth + 2) : void();
     os << Indent(depth + 1) << "},\n";
@@ -1037,7 +1069,7 @@ FunctionDef::FunctionDef(Node* parent, const std::string& signature, ExtFunction
     }
 }
 
-FunctionDef::FunctionDef(Node* parent, const Token& token, const std::function<void()>& shift)
+FunctionDef::FunctionDef(Node* parent, const Token& token, const std::function<void()>& shift, bool body)
     : Node(parent, token.line), symbols(&parent->Symbols()) {
     lFunc::RequireToken(token);
     shift();
@@ -1059,12 +1091,58 @@ FunctionDef::FunctionDef(Node* parent, const Token& token, const std::function<v
         Symbols().Set(name, Symbols()["any"].id, true, false);
     }
 
+    if (body) {
+        Body(token, shift);
+        MatchReturnType();
+    }
+}
+
+void FunctionDef::Body(const Token& token, const std::function<void()>& shift) {
     block = std::make_unique<Block>(this, token, shift);
     if (block->ReturnType() == 0) {
         block->returnType = Symbols()["void"].id;
     }
+}
+
+VarID FunctionDef::TakeBody(const Token& token, const std::function<void()>& shift) {
+    lCurlyOpen::RequireToken(token);
+    VarID identifiers = 0;
+    for (unsigned depth = 0; !lEoF::MatchToken(token);) {
+        pending.push_back(token);
+        identifiers += lIdentifier::MatchToken(token);
+        // Calls of a generator are compiled differently, so it is known before its body is parsed
+        isGenerator |= token.type == Token::Type::UnaryOperator && token.text == "yield";
+        if (lCurlyOpen::MatchToken(token)) {
+            ++depth;
+        } else if (lCurlyClose::MatchToken(token) && --depth == 0) {
+            shift();
+            break;
+        }
+        shift();
+    }
+    pending.emplace_back("", Token::Type::EoF, token.line);
+    return identifiers;
+}
+
+void FunctionDef::ParsePending() {
+    size_t position = 0;
+    Token token = pending.front();
+    try {
+        Body(token, [&]() { token = pending[std::min(++position, pending.size() - 1)]; });
+    } catch (const UndefinedIdentifierException& err) {
+        throw InterpreterException(err.what(), token.line);
+    } catch (const IdentifierRedefinitionException& err) {
+        throw InterpreterException(err.what(), token.line);
+    }
+    pending.clear();
+}
 
-    MatchType(name, block->ReturnType(), "wrong return type");
+// Return type of a function declared without one is the type its body returns
+void FunctionDef::MatchReturnType() {
+    // Calls of a generator from scripts give the array of values it yields
+    if (!isGenerator) {
+        MatchType(name, block->ReturnType(), "wrong return type");
+    }
 }
 
 void FunctionDef::Print(std::ostream& os, size_t depth) const {
@@ -1073,6 +1151,9 @@ void FunctionDef::Print(std::ostream& os, size_t depth) const {
     os << Indent(depth + 1) << "\"Symbols\": " << Symbols() << ",\n";
     arguments ? arguments->Print(os, depth + 1) : void();
     os << Indent(depth + 1) << "\"Returns\": \"" << Symbols()[Symbols()[name].type] << "\",\n";
+    if (isGenerator) {
+        os << Indent(depth + 1) << "\"Generator\": true,\n";
+    }
     block ? block->Print(os, depth + 1) : void();
     os << Indent(depth) << "},\n";
 }
@@ -1122,8 +1203,58 @@ void ObjectDef::Print(std::ostream& os, size_t depth) const {
     os << Indent(depth) << "},\n";
 }
 
-Global::Global(const Token& token, const std::function<void()>& shift)
-    : Node(nullptr, 0), symbols(nullptr) {
+namespace {
+
+// Body of a function left to be parsed after the rest of the file
+struct PendingBody {
+    FunctionDef* function;
+    // Last global id when the signature was parsed, the body doesn't see definitions after it
+    VarID declared;
+    VarID identifiers;
+};
+
+// Bodies number their symbols from ranges of their own so ids don't depend on the order the
+// bodies are parsed in, and see only definitions preceding them as bodies parsed in place do
+void NumberBodies(Global& global, const std::vector<PendingBody>& bodies) {
+    VarID last = global.symbols.LastID();
+    for (const auto& body : bodies) {
+        body.function->Symbols().Hide(body.declared, global.symbols.LastID());
+        body.function->Symbols().Number(last);
+        last += body.identifiers;
+    }
+    global.symbols.Number(last);
+}
+
+// Parses the bodies on the thread pool, errors are reported in the order of the definitions
+void ParseBodies(Global& global, const std::vector<PendingBody>& bodies) {
+    std::vector<std::exception_ptr> errors(bodies.size());
+    ThreadPool& pool = ThreadPool::Instance();
+    size_t chunks = std::min(bodies.size(), pool.Size() * 4);
+    global.concurrent = true;
+    pool.Run(chunks, [&](size_t chunk) {
+        for (size_t i = chunk * bodies.size() / chunks; i < (chunk + 1) * bodies.size() / chunks; ++i) {
+            try {
+                bodies[i].function->ParsePending();
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+    global.concurrent = false;
+
+    // Inferred return types are set only now so no body reads a type another one writes
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+        bodies[i].function->MatchReturnType();
+    }
+}
+
+} // namespace
+
+Global::Global(const Token& token, const std::function<void()>& shift, const ExternalDefinitions& externals, bool parallel, bool lazy)
+    : Node(nullptr, 0), symbols(nullptr), library(this, symbols) {
     // Add predefined symbols and functions
     symbols.Add("any");
     symbols.Add("void");
@@ -1135,17 +1266,51 @@ Global::Global(const Token& token, const std::function<void()>& shift)
     definitions.emplace_back(std::in_place_type<FunctionDef>, this, "func WriteLine(var message): void", &WriteLine);
     definitions.emplace_back(std::in_place_type<FunctionDef>, this, "func ReadNumber(): number", &ReadNumber);
     definitions.emplace_back(std::in_place_type<FunctionDef>, this, "func ReadText(): string", &ReadText);
+    symbols.Fallback(library.symbols);
+    // Library functions handle integers of the virtual machine and read arrays without copying them
+    library.functions.emplace_back(&library, "func Length(var value): number", Bound<true>(&Library::Length));
+    library.functions.emplace_back(&library, "func Substring(var text: string, var start: number, var count: number): string", Bound<true>(&Library::Substring));
+    library.functions.emplace_back(&library, "func Find(var text: string, var pattern: string): number", Bound<true>(&Library::Find));
+    library.functions.emplace_back(&library, "func Split(var text: string, var separator: string)", Bound<true>(&Library::Split));
+    library.functions.emplace_back(&library, "func Join(var values, var separator: string): string", Bound<true>(&Library::Join));
+    library.functions.emplace_back(&library, "func Floor(var value: number): number", Bound<true>(&Library::Floor));
+    library.functions.emplace_back(&library, "func Sqrt(var value: number): number", Bound<true>(&Library::Sqrt));
+    library.functions.emplace_back(&library, "func Pow(var base: number, var exponent: number): number", Bound<true>(&Library::Pow));
+    library.functions.emplace_back(&library, "func Min(var lhs: number, var rhs: number): number", Bound<true>(&Library::Min));
+    library.functions.emplace_back(&library, "func Max(var lhs: number, var rhs: number): number", Bound<true>(&Library::Max));
+    library.functions.emplace_back(&library, "func Format(var value: number, var decimals: number): string", Bound<true>(&Library::Format));
+    library.functions.emplace_back(&library, "func Total(var values): number", Bound<true>(&Library::Total));
+    library.functions.emplace_back(&library, "func Minimum(var values): number", Bound<true>(&Library::Minimum));
+    library.functions.emplace_back(&library, "func Maximum(var values): number", Bound<true>(&Library::Maximum));
+    library.functions.emplace_back(&library, "func Dot(var lhs, var rhs): number", Bound<true>(&Library::Dot));
+    library.functions.emplace_back(&library, "func Scaled(var values, var factor: number)", Bound<true>(&Library::Scaled));
+    library.functions.emplace_back(&library, "func Append(var values, var value)", Bound<true>(&Library::Append));
+    for (const auto& external : externals) {
+        auto function = external.function;
+        definitions.emplace_back(std::in_place_type<FunctionDef>, this, external.signature, std::move(function));
+    }
 
     try {
+        std::vector<PendingBody> bodies;
         while (!lEoF::MatchToken(token)) {
             if (FunctionDef::MatchToken(token)) {
-                definitions.emplace_back(std::in_place_type<FunctionDef>, this, token, shift);
+                auto& function = std::get<FunctionDef>(definitions.emplace_back(std::in_place_type<FunctionDef>, this, token, shift, !parallel && !lazy));
+                if (parallel || lazy) {
+                    VarID declared = symbols.LastID();
+                    bodies.push_back({ &function, declared, function.TakeBody(token, shift) });
+                }
             } else if (ObjectDef::MatchToken(token)) {
                 definitions.emplace_back(std::in_place_type<ObjectDef>, this, token, shift);
             } else {
                 throw ParseException(token, RuleGroup<FunctionDef, ObjectDef>::ExpectedToken());
             }
         }
+        NumberBodies(*this, bodies);
+        if (lazy) {
+            concurrent = true;
+        } else if (parallel) {
+            ParseBodies(*this, bodies);
+        }
     } catch (const UndefinedIdentifierException& err) {
         throw InterpreterException(err.what(), token.line);
     } catch (const IdentifierRedefinitionException& err) {
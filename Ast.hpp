@@ -6,6 +6,7 @@
 #include <memory>
 #include <string>
 #include <variant>
+#include <vector>
 
 #include "Helpers.hpp"
 #include "Rule.hpp"
@@ -28,6 +29,7 @@ using lSemicolon = TokenType<Token::Type::Semicolon>;
 using lString = TokenType<Token::Type::String>;
 using lNumber = TokenType<Token::Type::Number>;
 using lFor = TokenType<Token::Type::For>;
+using lParallel = TokenType<Token::Type::Parallel>;
 using lIn = TokenType<Token::Type::In>;
 using lIf = TokenType<Token::Type::If>;
 using lElseif = TokenType<Token::Type::Elseif>;
@@ -205,6 +207,9 @@ struct ArrayInitializer : public Node, public Rule<lSquareOpen, List<Expression>
 
 struct Arguments : public Node, public Rule<lParenOpen, List<Rule<VariableDef, lComma>>, lParenClose> {
     std::list<VariableDef> arguments;
+    // Types the arguments are declared with, calls check them while the body of the function may
+    // still be parsed on another thread
+    std::vector<VarID> types;
 
     Arguments(Node* parent, const Token& token, const std::function<void()>& shift);
     void Print(std::ostream& os, size_t depth) const override;
@@ -297,7 +302,9 @@ struct IfExpr : public Node, public Rule<If, List<Elseif>, Else> {
     VarID ReturnType(const SymbolTable* scope = nullptr) const override;
 };
 
-struct ForExpr : public Node, public Rule<lFor, VariableRef, lIn, Expression, Block> {
+struct ForExpr : public Node, public RuleGroup<Rule<lFor, VariableRef, lIn, Expression, Block>, Rule<lParallel, lFor, VariableRef, lIn, Expression, Block>> {
+    // Iterations may run concurrently when the body writes nothing shared between them
+    bool isParallel;
     std::unique_ptr<VariableDef> controlVariable;
     std::unique_ptr<Range> range;
     std::unique_ptr<Block> block;
@@ -349,11 +356,22 @@ struct FunctionDef : public Node, public Rule<lFunc, lIdentifier, Arguments, Blo
     std::unique_ptr<Arguments> arguments;
     std::unique_ptr<Block> block;
     SymbolTable symbols;
+    // Function with a yield in its body, resumed for each value it yields
+    bool isGenerator = false;
+    // Tokens of a body taken apart from the signature up to its closing brace, followed by the end
+    // of file and kept until the body is parsed by ParsePending
+    std::vector<Token> pending;
     
     ExtFunctionType externalFunction;
 
     FunctionDef(Node* parent, const std::string& signature, ExtFunctionType&& function);
-    FunctionDef(Node* parent, const Token& token, const std::function<void()>& shift);
+    // Without body only the signature is parsed, the body is parsed later by Body or ParsePending
+    FunctionDef(Node* parent, const Token& token, const std::function<void()>& shift, bool body = true);
+    void Body(const Token& token, const std::function<void()>& shift);
+    // Returns an upper bound of symbols the body can add, each of them is named by an identifier
+    VarID TakeBody(const Token& token, const std::function<void()>& shift);
+    void ParsePending();
+    void MatchReturnType();
     SymbolTable& Symbols() override { return symbols; }
     const SymbolTable& Symbols() const override { return symbols; }
     void Print(std::ostream& os, size_t depth) const override;
@@ -372,11 +390,35 @@ struct ObjectDef : public Node, public Rule<lObject, lIdentifier, lCurlyOpen, Li
     VarID ReturnType(const SymbolTable* scope = nullptr) const override { return 0; }
 };
 
+// Functions of the library, found by names the script doesn't define so scripts may define
+// functions of the same names. Their ids follow a base of their own and don't move ids of the script.
+struct LibraryScope : public Node {
+    static constexpr VarID FirstID = 1u << 20;
+
+    SymbolTable symbols;
+    std::list<FunctionDef> functions;
+
+    LibraryScope(Node* parent, SymbolTable& scope)
+        : Node(parent, 0), symbols(&scope) {
+        symbols.Number(FirstID);
+    }
+    SymbolTable& Symbols() override { return symbols; }
+    const SymbolTable& Symbols() const override { return symbols; }
+    void Print(std::ostream&, size_t) const override {}
+    VarID ReturnType(const SymbolTable* = nullptr) const override { return 0; }
+};
+
 struct Global : public Node, public Rule<List<RuleGroup<FunctionDef, ObjectDef>>, lEoF> {
     std::list<std::variant<FunctionDef, ObjectDef>> definitions;
     SymbolTable symbols;
-
-    Global(const Token& token, const std::function<void()>& shift);
+    LibraryScope library;
+    // Set while bodies of functions may be parsed on several threads or on the first call of their
+    // function, calls are then checked against the argument types of signatures
+    bool concurrent = false;
+
+    // When parallel, function bodies are parsed once all signatures and objects are known,
+    // concurrently on the thread pool. When lazy, bodies are left to ParsePending.
+    Global(const Token& token, const std::function<void()>& shift, const ExternalDefinitions& externals = {}, bool parallel = false, bool lazy = false);
     SymbolTable& Symbols() override { return symbols; }
     const SymbolTable& Symbols() const override { return symbols; }
     void Print(std::ostream& os, size_t depth) const override;
@@ -399,11 +441,14 @@ struct Global : public Node, public Rule<List<RuleGroup<FunctionDef, ObjectDef>>
                 val
             );
         });
-        if (it == definitions.end()) {
+        if (it != definitions.end()) {
+            return std::get<FunctionDef>(*it);
+        }
+        auto function = std::find_if(library.functions.begin(), library.functions.end(), [&](const FunctionDef& arg) { return arg.name == funcId; });
+        if (function == library.functions.end()) {
             throw UndefinedIdentifierException(funcId);
         }
-
-        return std::get<FunctionDef>(*it);
+        return *function;
     }
 
     const FunctionDef& GetFunction(const VarRef& funcRef) const {
@@ -443,9 +488,10 @@ class Ast {
     Global root;
 
 public:
-    Ast(const Token& token, const std::function<void()>& shift)
-        : root(token, shift) {}
+    Ast(const Token& token, const std::function<void()>& shift, const ExternalDefinitions& externals = {}, bool parallel = false, bool lazy = false)
+        : root(token, shift, externals, parallel, lazy) {}
 
+    Global& Root() { return root; }
     const Global& Root() const { return root; }
 
     friend std::ostream& operator<<(std::ostream& os, const Ast& ast) {
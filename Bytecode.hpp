@@ -0,0 +1,431 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Helpers.hpp"
+
+namespace Interpreter {
+
+// List of all instructions of the virtual machine. Operands a, b, c and d are register
+// indices unless stated otherwise, reference slots are marked with &.
+#define INTERPRETER_OPCODES(OPCODE) \
+    OPCODE(LoadConstant)    /* a = constants[b] */ \
+    OPCODE(Move)            /* a = b */ \
+    OPCODE(Add)             /* a = +(b, c) */ \
+    OPCODE(Subtract)        /* a = -(b, c) */ \
+    OPCODE(Multiply)        /* a = *(b, c) */ \
+    OPCODE(Divide)          /* a = /(b, c) */ \
+    OPCODE(Equal)           /* a = ==(b, c) */ \
+    OPCODE(NotEqual)        /* a = !=(b, c) */ \
+    OPCODE(Less)            /* a = <(b, c) */ \
+    OPCODE(LessEqual)       /* a = <=(b, c) */ \
+    OPCODE(Greater)         /* a = >(b, c) */ \
+    OPCODE(GreaterEqual)    /* a = >=(b, c) */ \
+    OPCODE(And)             /* a = &&(b, c) */ \
+    OPCODE(Or)              /* a = ||(b, c) */ \
+    OPCODE(Not)             /* a = !b */ \
+    OPCODE(Increment)       /* a = ++b */ \
+    OPCODE(Decrement)       /* a = --b */ \
+    OPCODE(Jump)            /* goto a */ \
+    OPCODE(JumpIfFalse)     /* if !a goto b */ \
+    OPCODE(JumpIfTrue)      /* if a goto b */ \
+    OPCODE(ForPrepare)      /* a = counter, a + 1 = limit, a + 2 = step, b = include last */ \
+    OPCODE(ForTest)         /* if counter a is past its limit goto b */ \
+    OPCODE(ForStep)         /* counter a += step */ \
+    OPCODE(Call)            /* a = functions[b](c...) */ \
+    OPCODE(CallExternal)    /* a = functions[b].externalFunction(c...) */ \
+    OPCODE(Return)          /* return a */ \
+    OPCODE(ReturnVoid)      /* return */ \
+    OPCODE(NewObject)       /* a = new layouts[b] { c... } */ \
+    OPCODE(NewArray)        /* a = [ b..b + c ], numbers are stored contiguously when d = 1 */ \
+    OPCODE(RefRegister)     /* &a = b */ \
+    OPCODE(RefField)        /* &a = &b.constants[c] */ \
+    OPCODE(RefIndex)        /* &a = &b[c] */ \
+    OPCODE(Load)            /* a = &b */ \
+    OPCODE(Store)           /* &a = b */ \
+    OPCODE(Fail)            /* throw constants[a] */ \
+    OPCODE(LoadFieldChain)  /* a = b.paths[c] */ \
+    OPCODE(EqualField)      /* a = ==(b.paths[c], d) */ \
+    OPCODE(AddConstant)     /* a = +(b, constants[c]) */ \
+    OPCODE(SubtractConstant) /* a = -(b, constants[c]) */ \
+    OPCODE(ForLoop)         /* counter a += step, if it is within its limit c = counter and goto b */ \
+    OPCODE(AddNumber)       /* a = +(b, c) of numbers */ \
+    OPCODE(SubtractNumber)  /* a = -(b, c) of numbers */ \
+    OPCODE(MultiplyNumber)  /* a = *(b, c) of numbers */ \
+    OPCODE(DivideNumber)    /* a = /(b, c) of numbers */ \
+    OPCODE(EqualNumber)     /* a = ==(b, c) of numbers */ \
+    OPCODE(NotEqualNumber)  /* a = !=(b, c) of numbers */ \
+    OPCODE(LessNumber)      /* a = <(b, c) of numbers */ \
+    OPCODE(LessEqualNumber) /* a = <=(b, c) of numbers */ \
+    OPCODE(GreaterNumber)   /* a = >(b, c) of numbers */ \
+    OPCODE(GreaterEqualNumber) /* a = >=(b, c) of numbers */ \
+    OPCODE(AddString)       /* a = +(b, c) of strings */ \
+    OPCODE(EqualString)     /* a = ==(b, c) of strings */ \
+    OPCODE(NotEqualString)  /* a = !=(b, c) of strings */ \
+    OPCODE(TailCall)        /* return functions[b](c...) in place of the current call, a = result for native code */ \
+    OPCODE(EqualConstant)   /* a = ==(b, constants[c]) */ \
+    OPCODE(NotEqualConstant) /* a = !=(b, constants[c]) */ \
+    OPCODE(LoadIndex)       /* a = &b[c] */ \
+    OPCODE(StoreIndex)      /* &a[b] = c */ \
+    OPCODE(Push)            /* append b to array a */ \
+    OPCODE(ParallelFor)     /* functions[b](counter a..a + 2, c...) over chunks of the range on the thread pool, sharing &d... */ \
+    OPCODE(Spawn)           /* a = handle of functions[b](c...) started on the thread pool */ \
+    OPCODE(Await)           /* a = result of the call with handle b once it finishes */ \
+    OPCODE(Yield)           /* suspend the generator with value b, a = null once it is resumed */ \
+    OPCODE(Collect)         /* a = [ values functions[b](c...) yields ] */
+
+enum class OpCode : unsigned char {
+#define INTERPRETER_OPCODE_ENUM(name) name,
+    INTERPRETER_OPCODES(INTERPRETER_OPCODE_ENUM)
+#undef INTERPRETER_OPCODE_ENUM
+};
+
+constexpr size_t OpCodeCount = 0
+#define INTERPRETER_OPCODE_COUNT(name) + 1
+    INTERPRETER_OPCODES(INTERPRETER_OPCODE_COUNT);
+#undef INTERPRETER_OPCODE_COUNT
+
+inline const char* OpCodeName(OpCode op) {
+    static const char* const names[] = {
+#define INTERPRETER_OPCODE_NAME(name) #name,
+        INTERPRETER_OPCODES(INTERPRETER_OPCODE_NAME)
+#undef INTERPRETER_OPCODE_NAME
+    };
+    return names[static_cast<size_t>(op)];
+}
+
+// Instruction an instruction specialized for statically typed operands falls back to
+inline OpCode Generic(OpCode op) {
+    switch (op) {
+    case OpCode::AddNumber:
+    case OpCode::AddString:
+        return OpCode::Add;
+    case OpCode::SubtractNumber:
+        return OpCode::Subtract;
+    case OpCode::MultiplyNumber:
+        return OpCode::Multiply;
+    case OpCode::DivideNumber:
+        return OpCode::Divide;
+    case OpCode::EqualNumber:
+    case OpCode::EqualString:
+        return OpCode::Equal;
+    case OpCode::NotEqualNumber:
+    case OpCode::NotEqualString:
+        return OpCode::NotEqual;
+    case OpCode::LessNumber:
+        return OpCode::Less;
+    case OpCode::LessEqualNumber:
+        return OpCode::LessEqual;
+    case OpCode::GreaterNumber:
+        return OpCode::Greater;
+    case OpCode::GreaterEqualNumber:
+        return OpCode::GreaterEqual;
+    default:
+        return op;
+    }
+}
+
+class NativeFunction;
+
+struct Instruction {
+    OpCode op;
+    unsigned a;
+    unsigned b;
+    unsigned c;
+    unsigned d;
+    unsigned line;
+
+    // Address of the instruction implementation used by threaded dispatch
+    mutable const void* handler = nullptr;
+
+    Instruction(OpCode op, unsigned a, unsigned b, unsigned c, unsigned d, unsigned line)
+        : op(op), a(a), b(b), c(c), d(d), line(line) {}
+
+    friend std::ostream& operator<<(std::ostream& os, const Instruction& instruction) {
+        return os << OpCodeName(instruction.op) << " " << instruction.a << " " << instruction.b << " " << instruction.c << " " << instruction.d << " (line " << instruction.line << ")";
+    }
+};
+
+// Results of a pure function by the arguments it was called with. Only calls whose arguments are
+// all void, bools, numbers or strings are cached, the least recently used result is evicted once
+// the cache is full.
+class Memo {
+    using Entries = std::list<std::pair<std::string, Value>>;
+
+    size_t capacity;
+    Entries entries;
+    std::unordered_map<std::string, Entries::iterator> index;
+    std::mutex mutex;
+    std::atomic<unsigned long long> hits{ 0 };
+    std::atomic<unsigned long long> misses{ 0 };
+    std::atomic<unsigned long long> evictions{ 0 };
+
+public:
+    explicit Memo(size_t capacity)
+        : capacity(capacity) {}
+
+    // Encodes the arguments into key, key stays empty when they can't be cached
+    static void Key(const Value* arguments, unsigned count, std::string& key) {
+        key.assign(1, static_cast<char>(count));
+        for (unsigned i = 0; i < count; ++i) {
+            const Value& argument = arguments[i];
+            if (IsNumber(argument)) {
+                // Integers and doubles of the same value are the same argument
+                double number = ToNumber(argument);
+                char bytes[sizeof(number)];
+                std::memcpy(bytes, &number, sizeof(number));
+                key += 'n';
+                key.append(bytes, sizeof(bytes));
+            } else if (const bool* boolean = std::get_if<bool>(&argument)) {
+                key += *boolean ? 't' : 'f';
+            } else if (const std::string* string = std::get_if<std::string>(&argument)) {
+                size_t size = string->size();
+                char bytes[sizeof(size)];
+                std::memcpy(bytes, &size, sizeof(size));
+                key += 's';
+                key.append(bytes, sizeof(bytes));
+                key += *string;
+            } else if (std::holds_alternative<std::monostate>(argument)) {
+                key += 'v';
+            } else {
+                key.clear();
+                return;
+            }
+        }
+    }
+
+    bool Find(const std::string& key, Value& result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        hits.fetch_add(1, std::memory_order_relaxed);
+        entries.splice(entries.begin(), entries, it->second);
+        result = it->second->second;
+        return true;
+    }
+
+    void Insert(std::string&& key, const Value& result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.count(key)) {
+            return;
+        }
+        if (entries.size() >= capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        entries.emplace_front(key, result);
+        index.emplace(std::move(key), entries.begin());
+    }
+
+    unsigned long long Hits() const { return hits.load(std::memory_order_relaxed); }
+    unsigned long long Misses() const { return misses.load(std::memory_order_relaxed); }
+    unsigned long long Evictions() const { return evictions.load(std::memory_order_relaxed); }
+
+    size_t Size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+};
+
+struct CompiledFunction {
+    VarID name = 0;
+    std::string identifier;
+    unsigned line = 0;
+    unsigned arguments = 0;
+    unsigned registers = 0;
+    unsigned references = 0;
+    // References the body of a parallel loop starts with, bound to variables of its caller
+    unsigned shared = 0;
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<std::vector<std::string>> paths;
+    ExtFunctionType externalFunction;
+
+    // Guards one time resolution of instruction handlers for threaded dispatch
+    mutable std::once_flag threaded;
+
+    // Calls counted until the function is compiled to machine code, native stays empty
+    // when the function can't be compiled
+    mutable std::atomic<unsigned> calls{ 0 };
+    mutable std::once_flag compiled;
+    mutable std::shared_ptr<const NativeFunction> native;
+
+    // Cached results of a pure function, empty when the function is not memoized
+    std::shared_ptr<Memo> memo;
+
+    // Generators suspend at each yield and are resumed from the instruction after it
+    bool generator = false;
+
+    // Body is parsed and compiled by Program::Load on the first call of the function
+    mutable std::atomic<bool> unloaded{ false };
+    mutable std::once_flag loaded;
+
+    bool IsExternal() const { return !std::holds_alternative<std::monostate>(externalFunction); }
+
+    void Print(std::ostream& os) const {
+        os << "func " << identifier << " (arguments: " << arguments << ", registers: " << registers << ", references: " << references << ")\n";
+        if (IsExternal()) {
+            os << "\texternal\n";
+            return;
+        }
+        if (unloaded) {
+            os << "\tunloaded\n";
+            return;
+        }
+        for (size_t i = 0; i < constants.size(); ++i) {
+            os << "\tk" << i << " = " << constants[i] << "\n";
+        }
+        for (size_t i = 0; i < paths.size(); ++i) {
+            os << "\tp" << i << " =";
+            for (const auto& key : paths[i]) {
+                os << " ." << key;
+            }
+            os << "\n";
+        }
+        for (size_t i = 0; i < code.size(); ++i) {
+            os << "\t" << i << ": " << code[i] << "\n";
+        }
+    }
+};
+
+// Call site whose callee body was compiled in place of the call
+struct InlinedCall {
+    std::string callee;
+    std::string caller;
+    unsigned line;
+};
+
+struct Program {
+    std::deque<CompiledFunction> functions;
+    std::vector<std::vector<std::string>> layouts;
+    std::map<std::string, size_t> names;
+    std::map<VarID, size_t> indices;
+    std::map<VarID, size_t> objects;
+    std::vector<InlinedCall> inlined;
+    unsigned jitThreshold = 0;
+    unsigned maxDepth = 0;
+
+    // Parses and compiles the body of an unloaded function, calls of it may come from several threads
+    std::function<void(Program&, CompiledFunction&)> load;
+
+    const CompiledFunction& GetFunction(const std::string& name) const {
+        auto it = names.find(name);
+        if (it == names.end()) {
+            throw UndefinedIdentifierException(name);
+        }
+        return functions[it->second];
+    }
+
+    // Function with its body compiled, an unloaded function is loaded once by the first call reaching it
+    const CompiledFunction& Load(const CompiledFunction& function) const {
+        if (function.unloaded.load(std::memory_order_acquire)) {
+            std::call_once(function.loaded, [&]() {
+                // Loading compiles only into the function itself, the rest of the program stays as it is
+                load(const_cast<Program&>(*this), const_cast<CompiledFunction&>(function));
+                function.unloaded.store(false, std::memory_order_release);
+            });
+        }
+        return function;
+    }
+
+    // Cache of a memoized function, throws when the function is not memoized
+    Memo& GetMemo(const std::string& name) const {
+        const CompiledFunction& function = GetFunction(name);
+        if (!function.memo) {
+            throw InterpreterException("Function " + name + " is not memoized.", function.line);
+        }
+        return *function.memo;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const Program& program) {
+        for (size_t i = 0; i < program.layouts.size(); ++i) {
+            os << "layout " << i << " {";
+            for (const auto& key : program.layouts[i]) {
+                os << " " << key;
+            }
+            os << " }\n";
+        }
+        for (const auto& call : program.inlined) {
+            os << "inlined " << call.callee << " into " << call.caller << " (line " << call.line << ")\n";
+        }
+        for (const auto& function : program.functions) {
+            function.Print(os);
+        }
+        return os;
+    }
+};
+
+// Counts of executed instructions and of pairs of instructions executed one after another,
+// used to find sequences worth fusing into superinstructions
+struct Profile {
+    std::vector<unsigned long long> instructions = std::vector<unsigned long long>(OpCodeCount);
+    std::vector<unsigned long long> pairs = std::vector<unsigned long long>(OpCodeCount * OpCodeCount);
+    size_t previous = OpCodeCount;
+
+    void Record(OpCode op) {
+        auto current = static_cast<size_t>(op);
+        ++instructions[current];
+        if (previous != OpCodeCount) {
+            ++pairs[previous * OpCodeCount + current];
+        }
+        previous = current;
+    }
+
+    unsigned long long Total() const {
+        unsigned long long total = 0;
+        for (auto count : instructions) {
+            total += count;
+        }
+        return total;
+    }
+
+    unsigned long long Count(OpCode op) const {
+        return instructions[static_cast<size_t>(op)];
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const Profile& profile) {
+        os << "Executed instructions: " << profile.Total() << "\n";
+        std::vector<std::pair<unsigned long long, size_t>> sorted;
+        for (size_t i = 0; i < profile.instructions.size(); ++i) {
+            if (profile.instructions[i]) {
+                sorted.emplace_back(profile.instructions[i], i);
+            }
+        }
+        std::sort(sorted.rbegin(), sorted.rend());
+        for (const auto& [count, op] : sorted) {
+            os << "\t" << OpCodeName(static_cast<OpCode>(op)) << ": " << count << "\n";
+        }
+
+        sorted.clear();
+        for (size_t i = 0; i < profile.pairs.size(); ++i) {
+            if (profile.pairs[i]) {
+                sorted.emplace_back(profile.pairs[i], i);
+            }
+        }
+        std::sort(sorted.rbegin(), sorted.rend());
+        os << "Most frequent pairs:\n";
+        for (size_t i = 0; i < sorted.size() && i < 10; ++i) {
+            os << "\t" << OpCodeName(static_cast<OpCode>(sorted[i].second / OpCodeCount)) << " -> "
+               << OpCodeName(static_cast<OpCode>(sorted[i].second % OpCodeCount)) << ": " << sorted[i].first << "\n";
+        }
+        return os;
+    }
+};
+
+} // namespace Interpreter
@@ -1,4 +1,6 @@
 #include "Interpreter"
+#include "Transpiler.hpp"
+#include <fstream>
 #include <iostream>
 
 std::string GetCommandDescription(const std::string& name, const std::string& usage, const std::string& description) {
@@ -8,8 +10,11 @@ std::string GetCommandDescription(const std::string& name, const std::string& us
 void Help() {
     std::cout << "==== Commands: ====\n" 
         << GetCommandDescription("Help", "-h", "Prints help.")
-        << GetCommandDescription("Tree", "-tree {source file name}", "Prints out ast tree of provided source file.")
-        << GetCommandDescription("Evaluate", "-eval {source file name} {function name} {function arguments...}", "Evaluates a function from source file with provided arguments.");
+        << GetCommandDescription("Tree", "-tree {source file name} {-optimized?}", "Prints out ast tree of provided source file, with constant expressions folded when -optimized is given.")
+        << GetCommandDescription("Bytecode", "-bytecode {source file name}", "Prints out compiled bytecode of provided source file.")
+        << GetCommandDescription("Evaluate", "-eval {source file name} {function name} {function arguments...}", "Evaluates a function from source file with provided arguments.")
+        << GetCommandDescription("Profile", "-profile {source file name} {function name} {function arguments...}", "Evaluates a function and prints out counts of executed instructions.")
+        << GetCommandDescription("Transpile", "-cpp {source file name} {output file name?}", "Translates functions of provided source file to C++ source that registers them as external functions.");
 }
 
 int Evaluate(int argc, char* argv[]) {
@@ -42,15 +47,50 @@ int Evaluate(int argc, char* argv[]) {
     return 0;
 }
 
-int Tree(int argc, char* argv[]) {
+int Profile(int argc, char* argv[]) {
     if (argc <= 0) {
         std::cerr << "Missing source file." << std::endl;
         Help();
         return -1;
     }
 
+    if (argc <= 1) {
+        std::cerr << "Missing function name to call." << std::endl;
+        Help();
+        return -1;
+    }
+
     try {
         Interpreter::Parser parser(argv[0]);
+        try {
+            using Interpreter::operator<<;
+            Interpreter::Profile profile;
+            Interpreter::VirtualMachine vm(parser.Bytecode(), Interpreter::Dispatch::Threaded, &profile);
+            std::cout << "Evaluation returned: " << vm.Call(argv[1], Interpreter::Parser::ParseArguments(argc - 2, &argv[2])) << "." << std::endl;
+            std::cout << profile;
+        } catch(const std::exception& err) {
+            std::cerr << "Failed to evaluate the provided function.\n" << err.what() << std::endl;
+            return -1;
+        }
+    } catch(const std::exception& err) {
+        std::cerr << "Failed to interpret the source file.\n" << err.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int Tree(int argc, char* argv[]) {
+    if (argc <= 0) {
+        std::cerr << "Missing source file." << std::endl;
+        Help();
+        return -1;
+    }
+
+    Interpreter::CompilerOptions options;
+    options.folding = argc > 1 && std::string(argv[1]) == "-optimized";
+    try {
+        Interpreter::Parser parser(argv[0], options);
         std::cout << parser.Tree();
     } catch(const std::exception& err) {
         std::cerr << "Failed to interpret the source file.\n" << err.what() << std::endl;
@@ -60,6 +100,53 @@ int Tree(int argc, char* argv[]) {
     return 0;
 }
 
+int Bytecode(int argc, char* argv[]) {
+    if (argc <= 0) {
+        std::cerr << "Missing source file." << std::endl;
+        Help();
+        return -1;
+    }
+
+    try {
+        Interpreter::Parser parser(argv[0]);
+        std::cout << parser.Bytecode();
+    } catch(const std::exception& err) {
+        std::cerr << "Failed to interpret the source file.\n" << err.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int Transpile(int argc, char* argv[]) {
+    if (argc <= 0) {
+        std::cerr << "Missing source file." << std::endl;
+        Help();
+        return -1;
+    }
+
+    try {
+        Interpreter::Parser parser(argv[0]);
+        auto source = Interpreter::Transpiler::Transpile(parser.Tree().Root(), argv[0]);
+        if (argc <= 1) {
+            std::cout << source;
+            return 0;
+        }
+
+        std::ofstream output(argv[1]);
+        output << source;
+        if (!output) {
+            std::cerr << "Failed to write the output file." << std::endl;
+            return -1;
+        }
+    } catch(const std::exception& err) {
+        std::cerr << "Failed to transpile the source file.\n" << err.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     if (argc <= 1) {
         std::cerr << "Missing command to execute." << std::endl;
@@ -72,10 +159,22 @@ int main(int argc, char* argv[]) {
         return Tree(argc - 2, &argv[2]);
     }
     
+    if (command == "-bytecode") {
+        return Bytecode(argc - 2, &argv[2]);
+    }
+
     if (command == "-eval") {
         return Evaluate(argc - 2, &argv[2]);
     }
 
+    if (command == "-profile") {
+        return Profile(argc - 2, &argv[2]);
+    }
+
+    if (command == "-cpp") {
+        return Transpile(argc - 2, &argv[2]);
+    }
+
     if (command == "-help") {
         Help();
         return 0;
@@ -0,0 +1,1126 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "Ast.hpp"
+#include "Bytecode.hpp"
+#include "LoopInvariants.hpp"
+#include "ParallelLoop.hpp"
+#include "Purity.hpp"
+
+namespace Interpreter {
+
+struct CompilerOptions {
+    // Fuses frequent instruction sequences, found by profiling the virtual machine, into superinstructions
+    bool superinstructions = true;
+
+    // Folds constant expressions and prunes constant branches and statements after a return of the
+    // tree before it is compiled
+    bool folding = true;
+
+    // Functions the host calls, definitions they can't reach are dropped before compilation. Empty
+    // keeps all definitions.
+    std::vector<std::string> entries = {};
+
+    // Computes expressions whose operands don't change within a loop once before the loop
+    bool hoisting = true;
+
+    // Emits instructions specialized for operands the typechecker knows to be numbers or strings
+    bool specialization = true;
+
+    // Largest number of instructions of a function whose body is substituted at its call sites,
+    // zero disables inlining
+    unsigned inlineBudget = 16;
+
+    // Calls in tail position replace the frame of the caller instead of growing the call stack
+    bool tailCalls = true;
+
+    // Number of calls from which a function runs as machine code, zero disables the compilation
+    unsigned jitThreshold = 100;
+
+    // Deepest nesting of calls, evaluation going deeper fails with an InterpreterException instead
+    // of running out of memory
+    unsigned maxDepth = 100000;
+
+    // Results cached per function whose result depends only on its arguments, zero disables
+    // memoization
+    unsigned memoSize = 0;
+
+    // Runs parallel for loops whose iterations are independent on the thread pool, other parallel
+    // loops and all loops when disabled run sequentially
+    bool parallel = true;
+
+    // Parses bodies of functions on the thread pool once all signatures and objects are known.
+    // Symbol ids then differ from those of sequential parsing and return types inferred from a
+    // body are not seen while other bodies are typechecked.
+    bool parallelParsing = false;
+
+    // Keeps only the signature and the tokens of each function body, the body is parsed,
+    // typechecked and compiled on the first call of its function. Errors in a body surface only
+    // once it is called, and bodies loaded this way are not searched for pure functions, not
+    // inlined and run their parallel loops sequentially. Entries are not pruned either.
+    bool lazyParsing = false;
+};
+
+class Compiler {
+    // Marks that the caller does not care in which register the result ends up
+    static constexpr unsigned NoTarget = ~0u;
+
+    Program& program;
+    const Global& root;
+    CompiledFunction& function;
+    const CompilerOptions& options;
+    const std::set<VarID>& pure;
+    std::map<VarID, unsigned> variables;
+
+    // Variables of the caller a parallel loop body reaches through the references it starts with
+    std::map<VarID, unsigned> shared;
+    unsigned top = 0;
+    unsigned floor = 0;
+    unsigned referenceTop = 0;
+
+    // Call being replaced by the body of the callee, its returns store the value and jump to exits
+    struct Inlining {
+        VarID callee;
+        unsigned result;
+        std::vector<size_t> exits;
+        Inlining* outer;
+    };
+    Inlining* inlining = nullptr;
+    std::map<VarID, bool> inlinable;
+
+    // Registers holding values of loop invariant expressions computed before the loop
+    std::map<const Expression*, unsigned> invariants;
+
+    Compiler(Program& program, const Global& root, CompiledFunction& function, const CompilerOptions& options, const std::set<VarID>& pure)
+        : program(program), root(root), function(function), options(options), pure(pure) {}
+
+public:
+    static Program Compile(const Global& root, const CompilerOptions& options = {}) {
+        Program program;
+        program.jitThreshold = options.jitThreshold;
+        program.maxDepth = options.maxDepth;
+
+        // Register all functions first so calls can be resolved independently of definition order
+        std::vector<const FunctionDef*> functions;
+        auto add = [&](const FunctionDef* func) {
+            // Functions of the script hide library functions of the same name from the host too
+            program.names.emplace(root.Symbols()[func->name].name, program.functions.size());
+            program.indices[func->name] = program.functions.size();
+            auto& compiled = program.functions.emplace_back();
+            compiled.name = func->name;
+            compiled.identifier = root.Symbols()[func->name].name;
+            compiled.line = func->line;
+            compiled.arguments = static_cast<unsigned>(func->arguments->arguments.size());
+            compiled.generator = func->isGenerator;
+            functions.push_back(func);
+        };
+        for (const auto& definition : root.definitions) {
+            if (const auto* func = std::get_if<FunctionDef>(&definition)) {
+                add(func);
+            }
+        }
+        for (const auto& func : root.library.functions) {
+            add(&func);
+        }
+
+        if (options.lazyParsing) {
+            // Layouts are all known upfront so loading a body adds nothing shared by running calls
+            for (const auto& definition : root.definitions) {
+                if (const auto* object = std::get_if<ObjectDef>(&definition)) {
+                    Layout(program, *object);
+                }
+            }
+            for (size_t i = 0; i < functions.size(); ++i) {
+                auto& compiled = program.functions[i];
+                if (!functions[i]->pending.empty()) {
+                    compiled.unloaded = true;
+                } else {
+                    Compiler(program, root, compiled, options, {}).Compile(*functions[i]);
+                }
+            }
+            return program;
+        }
+
+        auto pure = Purity::Find(root);
+        if (options.memoSize) {
+            // Functions of the library are pure as well but cheaper to call than to look up
+            for (VarID name : pure) {
+                auto index = program.indices.at(name);
+                if (std::holds_alternative<std::monostate>(functions[index]->externalFunction) && !functions[index]->isGenerator) {
+                    program.functions[index].memo = std::make_shared<Memo>(options.memoSize);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < functions.size(); ++i) {
+            Compiler(program, root, program.functions[i], options, pure).Compile(*functions[i]);
+        }
+        return program;
+    }
+
+    // Compiles a function whose body was parsed after the rest of the program, the function fails
+    // with error when its body couldn't be parsed
+    static void Load(Program& program, const Global& root, CompiledFunction& function, const CompilerOptions& options, const std::string& error = "") {
+        CompilerOptions loaded = options;
+        loaded.inlineBudget = 0;
+        loaded.parallel = false;
+        std::set<VarID> pure;
+        Compiler compiler(program, root, function, loaded, pure);
+        const FunctionDef& func = root.GetFunction(function.name);
+        if (error.empty()) {
+            compiler.Compile(func);
+            return;
+        }
+        for (const auto& argument : func.arguments->arguments) {
+            compiler.Variable(argument.name);
+        }
+        compiler.Fail(error, func.line, NoTarget);
+    }
+
+private:
+    void Compile(const FunctionDef& node) {
+        for (const auto& argument : node.arguments->arguments) {
+            Variable(argument.name);
+        }
+
+        if (!std::holds_alternative<std::monostate>(node.externalFunction)) {
+            function.externalFunction = node.externalFunction;
+            return;
+        }
+
+        Compile(*node.block);
+        Emit(OpCode::ReturnVoid, 0, 0, 0, node.line);
+    }
+
+    void Compile(const Block& node) {
+        for (const Statement& statement : node.statements) {
+            Compile(statement);
+        }
+    }
+
+    void Compile(const Statement& node) {
+        auto saved = top;
+        std::visit(
+            Visitor{
+                [&](const auto&) { throw InterpreterException("Unknown operation.", node.line); },
+                [&](const Return& arg) { Compile(arg); },
+                [&](const ForExpr& arg) { Compile(arg); },
+                [&](const IfExpr& arg) { Compile(arg); },
+                [&](const WhileExpr& arg) { Compile(arg); },
+                [&](const Expression& arg) { Compile(arg, NoTarget); },
+            },
+            node.expression);
+        Release(saved);
+    }
+
+    void Compile(const Return& node) {
+        if (node.value && function.generator && !inlining) {
+            Fail("Generator can't return a value.", node.line, NoTarget);
+            return;
+        }
+        if (inlining) {
+            if (node.value) {
+                Into(*node.value, inlining->result);
+            } else {
+                Emit(OpCode::LoadConstant, inlining->result, Constant(Value()), 0, node.line);
+            }
+            inlining->exits.push_back(Emit(OpCode::Jump, 0, 0, 0, node.line));
+            return;
+        }
+
+        if (node.value && TailCall(*node.value)) {
+            return;
+        }
+
+        if (node.value) {
+            Emit(OpCode::Return, Compile(*node.value, NoTarget), 0, 0, node.line);
+        } else {
+            Emit(OpCode::ReturnVoid, 0, 0, 0, node.line);
+        }
+    }
+
+    void Compile(const IfExpr& node) {
+        std::vector<size_t> exits;
+
+        // Branches with constant conditions need no jumps, none after an always taken one are reachable
+        auto branch = [&](const Expression& condition, const Block& block, bool isLast) {
+            if (const bool* constant = std::get_if<bool>(&condition.expression)) {
+                if (*constant) {
+                    Compile(block);
+                }
+                return *constant;
+            }
+
+            auto saved = top;
+            auto skip = Emit(OpCode::JumpIfFalse, Compile(condition, NoTarget), 0, 0, condition.line);
+            Release(saved);
+            Compile(block);
+            if (!isLast) {
+                exits.push_back(Emit(OpCode::Jump, 0, 0, 0, block.line));
+            }
+            function.code[skip].b = Here();
+            return false;
+        };
+
+        bool taken = branch(*node.ifStatement->condition, *node.ifStatement->block, node.elseifStatements.empty() && !node.elseStatement);
+        for (auto it = node.elseifStatements.begin(); !taken && it != node.elseifStatements.end(); ++it) {
+            taken = branch(*it->condition, *it->block, std::next(it) == node.elseifStatements.end() && !node.elseStatement);
+        }
+        if (!taken && node.elseStatement) {
+            Compile(*node.elseStatement->block);
+        }
+
+        for (auto exit : exits) {
+            function.code[exit].a = Here();
+        }
+    }
+
+    void Compile(const WhileExpr& node) {
+        const bool* constant = std::get_if<bool>(&node.condition->expression);
+        auto hoisted = Invariants(node);
+        if (node.isDoWhile) {
+            Hoist(hoisted);
+            auto start = Here();
+            Compile(*node.block);
+            if (constant) {
+                if (*constant) {
+                    Emit(OpCode::Jump, start, 0, 0, node.condition->line);
+                }
+            } else {
+                auto saved = top;
+                Emit(OpCode::JumpIfTrue, Compile(*node.condition, NoTarget), start, 0, node.condition->line);
+                Release(saved);
+            }
+            Unhoist(hoisted);
+            return;
+        }
+
+        if (constant) {
+            if (*constant) {
+                Hoist(hoisted);
+                auto start = Here();
+                Compile(*node.block);
+                Emit(OpCode::Jump, start, 0, 0, node.line);
+                Unhoist(hoisted);
+            }
+            return;
+        }
+
+        // Loop with invariants is entered through a copy of its condition so they are computed only
+        // when the body runs, the condition is then tested at the end of each iteration
+        if (!hoisted.empty()) {
+            auto saved = top;
+            auto exit = Emit(OpCode::JumpIfFalse, Compile(*node.condition, NoTarget), 0, 0, node.condition->line);
+            Release(saved);
+            Hoist(hoisted);
+            auto start = Here();
+            Compile(*node.block);
+            saved = top;
+            Emit(OpCode::JumpIfTrue, Compile(*node.condition, NoTarget), start, 0, node.condition->line);
+            Release(saved);
+            function.code[exit].b = Here();
+            Unhoist(hoisted);
+            return;
+        }
+
+        auto start = Here();
+        auto saved = top;
+        auto exit = Emit(OpCode::JumpIfFalse, Compile(*node.condition, NoTarget), 0, 0, node.condition->line);
+        Release(saved);
+        Compile(*node.block);
+        Emit(OpCode::Jump, start, 0, 0, node.line);
+        function.code[exit].b = Here();
+    }
+
+    void Compile(const ForExpr& node) {
+        if (!node.range->to) {
+            Fail("For loop range must have both bounds.", node.line, NoTarget);
+            return;
+        }
+
+        // Counter, limit and step of the loop live in three consecutive hidden registers
+        auto counter = Temporary();
+        Temporary();
+        Temporary();
+        ParallelLoop::Captures captures;
+        bool parallel = options.parallel && node.isParallel && ParallelLoop::Find(node, pure, captures) && Captured(captures);
+        auto control = parallel ? NoTarget : Variable(node.controlVariable->name);
+
+        Into(*node.range->from, counter);
+        Into(*node.range->to, counter + 1);
+        Emit(OpCode::ForPrepare, counter, node.range->shouldIncludeLast, 0, node.line);
+        if (parallel) {
+            Parallel(node, counter, captures);
+        } else {
+            Iterate(node, counter, control);
+        }
+    }
+
+    // Iterates over the range prepared in the three registers from counter
+    void Iterate(const ForExpr& node, unsigned counter, unsigned control) {
+        // Invariants are computed after the first test so an empty range doesn't evaluate them
+        auto hoisted = Invariants(node);
+        std::vector<size_t> exits;
+        if (!hoisted.empty()) {
+            exits.push_back(Emit(OpCode::ForTest, counter, 0, 0, node.line));
+            Hoist(hoisted);
+        }
+
+        auto start = Here();
+        exits.push_back(Emit(OpCode::ForTest, counter, 0, 0, node.line));
+        Emit(OpCode::Move, control, counter, 0, node.line);
+        Compile(*node.block);
+        if (options.superinstructions) {
+            Emit(OpCode::ForLoop, counter, start + 2, control, node.line);
+        } else {
+            Emit(OpCode::ForStep, counter, 0, 0, node.line);
+            Emit(OpCode::Jump, start, 0, 0, node.line);
+        }
+        for (auto exit : exits) {
+            function.code[exit].b = Here();
+        }
+        Unhoist(hoisted);
+    }
+
+    // Variables captured by a parallel loop are in registers, not reached through references of a
+    // loop body this one is nested in
+    bool Captured(const ParallelLoop::Captures& captures) const {
+        auto known = [&](VarID name) { return variables.count(name) > 0; };
+        return std::all_of(captures.copied.begin(), captures.copied.end(), known) && std::all_of(captures.shared.begin(), captures.shared.end(), known);
+    }
+
+    // Body of the loop becomes a function of its own that runs a chunk of the range. Copied
+    // variables are passed to it after the counter, shared ones through references.
+    void Parallel(const ForExpr& node, unsigned counter, const ParallelLoop::Captures& captures) {
+        auto index = static_cast<unsigned>(program.functions.size());
+        auto& body = program.functions.emplace_back();
+        body.name = function.name;
+        body.identifier = function.identifier + " parallel for on line " + std::to_string(node.line);
+        body.line = node.line;
+        Compiler(program, root, body, options, pure).Compile(node, captures);
+
+        auto first = top;
+        for (VarID name : captures.copied) {
+            Emit(OpCode::Move, Temporary(), variables.at(name), 0, node.line);
+        }
+        auto savedReferences = referenceTop;
+        for (VarID name : captures.shared) {
+            Emit(OpCode::RefRegister, Reference(), variables.at(name), 0, node.line);
+        }
+        Emit(OpCode::ParallelFor, counter, index, first, savedReferences, node.line);
+        referenceTop = savedReferences;
+    }
+
+    void Compile(const ForExpr& node, const ParallelLoop::Captures& captures) {
+        auto counter = Temporary();
+        Temporary();
+        Temporary();
+        for (VarID name : captures.copied) {
+            Variable(name);
+        }
+        function.arguments = top;
+        for (VarID name : captures.shared) {
+            shared[name] = Reference();
+        }
+        function.shared = referenceTop;
+
+        Iterate(node, counter, Variable(node.controlVariable->name));
+        Emit(OpCode::ReturnVoid, 0, 0, 0, node.line);
+    }
+
+    template <typename Loop>
+    std::vector<const Expression*> Invariants(const Loop& node) const {
+        return options.hoisting ? LoopInvariants::Find(node) : std::vector<const Expression*>();
+    }
+
+    // Registers of the invariants stay reserved like variables for the rest of the function
+    void Hoist(const std::vector<const Expression*>& hoisted) {
+        std::vector<unsigned> registers;
+        for (size_t i = 0; i < hoisted.size(); ++i) {
+            registers.push_back(Temporary());
+        }
+        floor = top;
+        for (size_t i = 0; i < hoisted.size(); ++i) {
+            Into(*hoisted[i], registers[i]);
+            Release(floor);
+            invariants[hoisted[i]] = registers[i];
+        }
+    }
+
+    void Unhoist(const std::vector<const Expression*>& hoisted) {
+        for (const auto* expression : hoisted) {
+            invariants.erase(expression);
+        }
+    }
+
+    // Compiles expression and returns register that holds its value. Result is placed into target if it is
+    // provided and the value is not already available in another register, e.g. in a variable.
+    unsigned Compile(const Expression& node, unsigned target) {
+        if (auto invariant = invariants.find(&node); invariant != invariants.end()) {
+            return invariant->second;
+        }
+
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> unsigned { throw InterpreterException("Unknown operation.", node.line); },
+                [&](const UnaryOperation& arg) { return Compile(arg, target); },
+                [&](const BinaryOperation& arg) { return Compile(arg, target); },
+                [&](const VariableRef& arg) { return Compile(arg, target); },
+                [&](const VariableDef& arg) { return Compile(arg); },
+                [&](const ObjectInitializer& arg) { return Compile(arg, target); },
+                [&](const ArrayInitializer& arg) { return Compile(arg, target); },
+                [&](bool arg) { return Load(Value(arg), node.line, target); },
+                [&](double arg) { return Load(Integral(arg), node.line, target); },
+                [&](const std::string& arg) { return Load(Value(arg), node.line, target); },
+            },
+            node.expression);
+    }
+
+    // Compiles expression with its result always placed into target register
+    void Into(const Expression& node, unsigned target) {
+        auto result = Compile(node, target);
+        if (result != target) {
+            Emit(OpCode::Move, target, result, 0, node.line);
+        }
+    }
+
+    unsigned Compile(const UnaryOperation& node, unsigned target) {
+        static const std::map<std::string, OpCode> operations = {
+            { "!", OpCode::Not },
+            { "++", OpCode::Increment },
+            { "--", OpCode::Decrement },
+            { "await", OpCode::Await },
+            { "yield", OpCode::Yield },
+        };
+        if (node.operation == "spawn") {
+            return Spawn(node, target);
+        }
+        auto operation = operations.find(node.operation);
+        if (operation == operations.end()) {
+            return Fail("Operator " + node.operation + " not implemented.", node.line, target);
+        }
+
+        auto value = Compile(*node.value, NoTarget);
+        auto result = Target(target);
+        Emit(operation->second, result, value, 0, node.line);
+        return result;
+    }
+
+    // Arguments of a spawned call are passed in consecutive registers like those of a call, the
+    // target receives the handle of the task instead of the result
+    unsigned Spawn(const UnaryOperation& node, unsigned target) {
+        const auto* ref = std::get_if<VariableRef>(&node.value->expression);
+        const auto* call = ref && ref->chainedOperation ? std::get_if<FunctionCall>(&ref->chainedOperation->operation) : nullptr;
+        if (!call || call->chainedOperation) {
+            return Fail("Spawn expects a function call.", node.line, target);
+        }
+        const FunctionDef* func = nullptr;
+        try {
+            func = &root.GetFunction(call->identifier);
+        } catch (const UndefinedIdentifierException& err) {
+            return Fail(err.what(), node.line, target);
+        }
+        if (call->arguments.size() != func->arguments->arguments.size()) {
+            return Fail(TypeMismatchException(std::to_string(call->arguments.size()) + "arg(s)", std::to_string(func->arguments->arguments.size()) + "arg(s)", node.line, "function call with incorrect arguments").what(), node.line, target);
+        }
+
+        auto first = top;
+        for (size_t i = 0; i < call->arguments.size(); ++i) {
+            Temporary();
+        }
+        auto argument = first;
+        for (const auto& arg : call->arguments) {
+            Into(arg, argument++);
+        }
+        auto result = Target(target);
+        Emit(OpCode::Spawn, result, static_cast<unsigned>(program.indices.at(func->name)), first, node.line);
+        return result;
+    }
+
+    unsigned Compile(const BinaryOperation& node, unsigned target) {
+        static const std::map<std::string, OpCode> operations = {
+            { "==", OpCode::Equal },
+            { "!=", OpCode::NotEqual },
+            { "<", OpCode::Less },
+            { "<=", OpCode::LessEqual },
+            { ">", OpCode::Greater },
+            { ">=", OpCode::GreaterEqual },
+            { "+", OpCode::Add },
+            { "-", OpCode::Subtract },
+            { "*", OpCode::Multiply },
+            { "/", OpCode::Divide },
+            { "&&", OpCode::And },
+            { "||", OpCode::Or },
+        };
+        auto operation = operations.find(node.operation);
+        if (operation == operations.end()) {
+            return Fail("Operator " + node.operation + " not implemented.", node.line, target);
+        }
+
+        if (options.superinstructions) {
+            // Comparison of an object field with a local variable, e.g. ==(grid.X.A, player)
+            if (operation->second == OpCode::Equal) {
+                std::vector<std::string> path;
+                auto local = Local(*node.rhs);
+                auto object = local != NoTarget ? FieldChain(*node.lhs, path) : NoTarget;
+                if (object == NoTarget) {
+                    local = Local(*node.lhs);
+                    object = local != NoTarget ? FieldChain(*node.rhs, path) : NoTarget;
+                }
+                if (object != NoTarget) {
+                    auto result = Target(target);
+                    Emit(OpCode::EqualField, result, object, Path(std::move(path)), local, node.line);
+                    return result;
+                }
+            }
+
+            // Update by a number literal, e.g. i = +(i, 1)
+            const double* constant = std::get_if<double>(&node.rhs->expression);
+            if (constant && (operation->second == OpCode::Add || operation->second == OpCode::Subtract)) {
+                auto lhs = Compile(*node.lhs, NoTarget);
+                auto result = Target(target);
+                Emit(operation->second == OpCode::Add ? OpCode::AddConstant : OpCode::SubtractConstant, result, lhs, Constant(Integral(*constant)), node.line);
+                return result;
+            }
+
+            // String literals are read from the constants in place instead of being copied into a
+            // register first, e.g. ==(name, "World") or +(text, "!")
+            const Expression* other = node.lhs.get();
+            const std::string* text = std::get_if<std::string>(&node.rhs->expression);
+            if (!text && operation->second != OpCode::Add) {
+                other = node.rhs.get();
+                text = std::get_if<std::string>(&node.lhs->expression);
+            }
+            static const std::map<OpCode, OpCode> literals = {
+                { OpCode::Add, OpCode::AddConstant },
+                { OpCode::Equal, OpCode::EqualConstant },
+                { OpCode::NotEqual, OpCode::NotEqualConstant },
+            };
+            if (text && literals.count(operation->second)) {
+                auto value = Compile(*other, NoTarget);
+                auto result = Target(target);
+                Emit(literals.at(operation->second), result, value, Constant(Value(*text)), node.line);
+                return result;
+            }
+        }
+
+        auto lhs = Compile(*node.lhs, NoTarget);
+        auto rhs = Compile(*node.rhs, NoTarget);
+        auto result = Target(target);
+        Emit(options.specialization ? Specialize(operation->second, node) : operation->second, result, lhs, rhs, node.line);
+        return result;
+    }
+
+    // Typed variables can still be assigned values of other types, specialized instructions check
+    // their operands and fall back to the generic operators
+    OpCode Specialize(OpCode op, const BinaryOperation& node) const {
+        static const std::map<OpCode, OpCode> numbers = {
+            { OpCode::Add, OpCode::AddNumber },
+            { OpCode::Subtract, OpCode::SubtractNumber },
+            { OpCode::Multiply, OpCode::MultiplyNumber },
+            { OpCode::Divide, OpCode::DivideNumber },
+            { OpCode::Equal, OpCode::EqualNumber },
+            { OpCode::NotEqual, OpCode::NotEqualNumber },
+            { OpCode::Less, OpCode::LessNumber },
+            { OpCode::LessEqual, OpCode::LessEqualNumber },
+            { OpCode::Greater, OpCode::GreaterNumber },
+            { OpCode::GreaterEqual, OpCode::GreaterEqualNumber },
+        };
+        static const std::map<OpCode, OpCode> strings = {
+            { OpCode::Add, OpCode::AddString },
+            { OpCode::Equal, OpCode::EqualString },
+            { OpCode::NotEqual, OpCode::NotEqualString },
+        };
+
+        auto type = node.lhs->ReturnType();
+        if (type != node.rhs->ReturnType()) {
+            return op;
+        }
+        const auto& specialized = type == root.Symbols()["number"].id ? numbers : type == root.Symbols()["string"].id ? strings : std::map<OpCode, OpCode>();
+        auto it = specialized.find(op);
+        return it != specialized.end() ? it->second : op;
+    }
+
+    unsigned Compile(const VariableRef& node, unsigned target) {
+        if (node.Symbols()[node.name].isFunction) {
+            if (!node.chainedOperation) {
+                return Fail("Function " + node.Symbols()[node.name].name + " can't be used as a value.", node.line, target);
+            }
+            return Compile(*node.chainedOperation, 0, NoTarget, target);
+        }
+
+        // Variables shared with a parallel loop body are only read or assigned as elements
+        if (auto slot = shared.find(node.name); slot != shared.end()) {
+            if (!node.chainedOperation) {
+                auto result = Target(target);
+                Emit(OpCode::Load, result, slot->second, 0, node.line);
+                return result;
+            }
+            auto value = NoTarget;
+            if (const auto* assign = Assignment(*node.chainedOperation)) {
+                value = Compile(*assign->value, NoTarget);
+            }
+            return Compile(*node.chainedOperation, slot->second, value, target);
+        }
+
+        auto variable = variables.find(node.name);
+        if (variable == variables.end()) {
+            return Fail("Variable with id " + std::to_string(node.name) + " not found.", node.line, target);
+        }
+        if (!node.chainedOperation) {
+            return variable->second;
+        }
+
+        // Reads through dot operators only are loaded by a single instruction
+        if (std::vector<std::string> path; FieldChain(node, path) != NoTarget) {
+            auto result = Target(target);
+            Emit(OpCode::LoadFieldChain, result, variable->second, Path(std::move(path)), node.line);
+            return result;
+        }
+
+        // Plain assignment writes the value straight into the variable register
+        if (const auto* assign = std::get_if<VariableAssign>(&node.chainedOperation->operation)) {
+            if (const auto* element = Appended(*assign->value, node.name)) {
+                Emit(OpCode::Push, variable->second, Compile(*element, NoTarget), 0, node.line);
+                return variable->second;
+            }
+            Into(*assign->value, variable->second);
+            return variable->second;
+        }
+
+        // Value of an assignment at the end of the chain is evaluated before the chain is walked
+        // so no reference can be invalidated while the value is being computed
+        auto value = NoTarget;
+        if (const auto* assign = Assignment(*node.chainedOperation)) {
+            value = Compile(*assign->value, NoTarget);
+        }
+
+        auto savedReferences = referenceTop;
+        auto reference = Reference();
+        Emit(OpCode::RefRegister, reference, variable->second, 0, node.line);
+        auto result = Compile(*node.chainedOperation, reference, value, target);
+        referenceTop = savedReferences;
+        return result;
+    }
+
+    unsigned Compile(const ChainedOperation& node, unsigned reference, unsigned value, unsigned target) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> unsigned { throw InterpreterException("Unknown operation.", node.line); },
+                [&](const DotOperation& arg) { return Compile(arg, reference, value, target); },
+                [&](const IndexOperation& arg) { return Compile(arg, reference, value, target); },
+                [&](const VariableAssign& arg) {
+                    Emit(OpCode::Store, reference, value, 0, arg.line);
+                    return value;
+                },
+                [&](const FunctionCall& arg) { return Compile(arg, target); },
+            },
+            node.operation);
+    }
+
+    unsigned Compile(const DotOperation& node, unsigned reference, unsigned value, unsigned target) {
+        if (!std::holds_alternative<std::string>(node.attribute) && node.scope[node.attribute].isFunction) {
+            if (!node.chainedOperation) {
+                return Fail("Function " + node.scope[node.attribute].name + " can't be used as a value.", node.line, target);
+            }
+            return Compile(*node.chainedOperation, reference, value, target);
+        }
+
+        Emit(OpCode::RefField, reference, reference, Constant(Value(Key(node))), node.line);
+        return Continue(node.chainedOperation, reference, value, target, node.line);
+    }
+
+    unsigned Compile(const IndexOperation& node, unsigned reference, unsigned value, unsigned target) {
+        auto key = Compile(*node.index, NoTarget);
+        if (!node.chainedOperation) {
+            auto result = Target(target);
+            Emit(OpCode::LoadIndex, result, reference, key, node.line);
+            return result;
+        }
+        if (std::holds_alternative<VariableAssign>(node.chainedOperation->operation)) {
+            Emit(OpCode::StoreIndex, reference, key, value, node.line);
+            return value;
+        }
+        Emit(OpCode::RefIndex, reference, reference, key, node.line);
+        return Continue(node.chainedOperation, reference, value, target, node.line);
+    }
+
+    unsigned Continue(const std::unique_ptr<ChainedOperation>& chain, unsigned reference, unsigned value, unsigned target, unsigned line) {
+        if (chain) {
+            return Compile(*chain, reference, value, target);
+        }
+        auto result = Target(target);
+        Emit(OpCode::Load, result, reference, 0, line);
+        return result;
+    }
+
+    unsigned Compile(const FunctionCall& node, unsigned target) {
+        const FunctionDef* func = nullptr;
+        try {
+            func = &root.GetFunction(node.identifier);
+        } catch (const UndefinedIdentifierException& err) {
+            return Fail(err.what(), node.line, target);
+        }
+        if (node.arguments.size() != func->arguments->arguments.size()) {
+            return Fail(TypeMismatchException(std::to_string(node.arguments.size()) + "arg(s)", std::to_string(func->arguments->arguments.size()) + "arg(s)", node.line, "function call with incorrect arguments").what(), node.line, target);
+        }
+
+        // Arguments are passed in consecutive registers
+        auto first = top;
+        for (size_t i = 0; i < node.arguments.size(); ++i) {
+            Temporary();
+        }
+        auto argument = first;
+        for (const auto& arg : node.arguments) {
+            Into(arg, argument++);
+        }
+
+        auto result = Target(target);
+        if (func->isGenerator) {
+            Emit(OpCode::Collect, result, static_cast<unsigned>(program.indices.at(func->name)), first, node.line);
+        } else if (Inlinable(*func)) {
+            Inline(*func, first, result, node.line);
+        } else {
+            auto opcode = std::holds_alternative<std::monostate>(func->externalFunction) ? OpCode::Call : OpCode::CallExternal;
+            Emit(opcode, result, static_cast<unsigned>(program.indices.at(func->name)), first, node.line);
+        }
+        if (!node.chainedOperation) {
+            return result;
+        }
+
+        auto savedReferences = referenceTop;
+        auto reference = Reference();
+        Emit(OpCode::RefRegister, reference, result, 0, node.line);
+        auto value = NoTarget;
+        if (const auto* assign = Assignment(*node.chainedOperation)) {
+            value = Compile(*assign->value, NoTarget);
+        }
+        result = Compile(*node.chainedOperation, reference, value, target);
+        referenceTop = savedReferences;
+        return result;
+    }
+
+    // Element of data = Append(data, element), the array is extended in place instead of being
+    // copied into the call and back
+    const Expression* Appended(const Expression& node, VarID name) const {
+        const auto* ref = std::get_if<VariableRef>(&node.expression);
+        if (!ref || !ref->chainedOperation || ref->name != root.library.Symbols()["Append"].id) {
+            return nullptr;
+        }
+        const auto* call = std::get_if<FunctionCall>(&ref->chainedOperation->operation);
+        if (!call || call->chainedOperation || call->arguments.size() != 2) {
+            return nullptr;
+        }
+        const auto* array = std::get_if<VariableRef>(&call->arguments.front().expression);
+        return array && array->name == name && !array->chainedOperation ? &call->arguments.back() : nullptr;
+    }
+
+    // Returned call of a script function that is not inlined reuses the frame, the return after it is
+    // only reached by native code that performs the call as a regular one
+    bool TailCall(const Expression& node) {
+        const auto* ref = std::get_if<VariableRef>(&node.expression);
+        if (!options.tailCalls || !ref || !ref->chainedOperation || !ref->Symbols()[ref->name].isFunction) {
+            return false;
+        }
+        const auto* call = std::get_if<FunctionCall>(&ref->chainedOperation->operation);
+        if (!call || call->chainedOperation) {
+            return false;
+        }
+
+        const FunctionDef* func = nullptr;
+        try {
+            func = &root.GetFunction(call->identifier);
+        } catch (const UndefinedIdentifierException&) {
+            return false;
+        }
+        if (call->arguments.size() != func->arguments->arguments.size() || !std::holds_alternative<std::monostate>(func->externalFunction) || func->isGenerator || Inlinable(*func)) {
+            return false;
+        }
+
+        auto first = top;
+        for (size_t i = 0; i < call->arguments.size(); ++i) {
+            Temporary();
+        }
+        auto argument = first;
+        for (const auto& arg : call->arguments) {
+            Into(arg, argument++);
+        }
+        auto result = Temporary();
+        Emit(OpCode::TailCall, result, static_cast<unsigned>(program.indices.at(func->name)), first, call->line);
+        Emit(OpCode::Return, result, 0, 0, node.line);
+        return true;
+    }
+
+    // Functions are inlined when they fit into the budget compiled on their own and don't call themselves.
+    // Calls from within the inlined body are not inlined into it again so mutual recursion terminates.
+    bool Inlinable(const FunctionDef& func) {
+        if (!options.inlineBudget || !std::holds_alternative<std::monostate>(func.externalFunction) || func.isGenerator || func.name == function.name) {
+            return false;
+        }
+        for (auto* outer = inlining; outer; outer = outer->outer) {
+            if (outer->callee == func.name) {
+                return false;
+            }
+        }
+
+        auto it = inlinable.find(func.name);
+        if (it != inlinable.end()) {
+            return it->second;
+        }
+        CompilerOptions standalone = options;
+        standalone.inlineBudget = 0;
+        standalone.parallel = false;
+        CompiledFunction compiled;
+        compiled.name = func.name;
+        Compiler(program, root, compiled, standalone, pure).Compile(func);
+        auto index = static_cast<unsigned>(program.indices.at(func.name));
+        bool recursive = std::any_of(compiled.code.begin(), compiled.code.end(), [&](const Instruction& instruction) {
+            return (instruction.op == OpCode::Call || instruction.op == OpCode::TailCall) && instruction.b == index;
+        });
+        return inlinable[func.name] = !recursive && compiled.code.size() <= options.inlineBudget;
+    }
+
+    // Body of the callee works on registers above the call, arguments are already copied into
+    // consecutive registers from first the same way a call passes them
+    void Inline(const FunctionDef& func, unsigned first, unsigned result, unsigned line) {
+        auto savedVariables = variables;
+        auto savedTop = top;
+        auto savedFloor = floor;
+        auto argument = first;
+        for (const auto& parameter : func.arguments->arguments) {
+            variables[parameter.name] = argument++;
+        }
+        floor = top;
+
+        Inlining context{ func.name, result, {}, inlining };
+        inlining = &context;
+        Compile(*func.block);
+        inlining = context.outer;
+
+        // Return as the last statement jumps right after itself and nothing falls through past it
+        const auto& statements = func.block->statements;
+        if (statements.empty() || !std::holds_alternative<Return>(statements.back().expression)) {
+            Emit(OpCode::LoadConstant, result, Constant(Value()), 0, func.line);
+        } else if (!context.exits.empty() && context.exits.back() == function.code.size() - 1) {
+            function.code.pop_back();
+            context.exits.pop_back();
+        }
+        for (auto exit : context.exits) {
+            function.code[exit].a = Here();
+        }
+
+        variables = std::move(savedVariables);
+        top = savedTop;
+        floor = savedFloor;
+        program.inlined.push_back({ root.Symbols()[func.name].name, function.identifier, line });
+    }
+
+    unsigned Compile(const VariableDef& node) {
+        auto variable = Variable(node.name);
+        if (node.value) {
+            Into(*node.value, variable);
+        } else {
+            Emit(OpCode::LoadConstant, variable, Constant(Value()), 0, node.line);
+        }
+        return variable;
+    }
+
+    unsigned Compile(const ObjectInitializer& node, unsigned target) {
+        const ObjectDef& objectDef = root.GetObject(node.type);
+
+        auto first = top;
+        for (size_t i = 0; i < objectDef.attributes.size(); ++i) {
+            Temporary();
+        }
+        auto attributeRegister = first;
+        for (const auto& attribute : objectDef.attributes) {
+            auto expressionIt = node.values.find(attribute.name);
+            if (expressionIt != node.values.end()) {
+                Into(expressionIt->second, attributeRegister);
+            } else if (attribute.value) {
+                Into(*attribute.value, attributeRegister);
+            } else {
+                Emit(OpCode::LoadConstant, attributeRegister, Constant(Value()), 0, node.line);
+            }
+            ++attributeRegister;
+        }
+
+        auto result = Target(target);
+        Emit(OpCode::NewObject, result, Layout(program, objectDef), first, node.line);
+        return result;
+    }
+
+    unsigned Compile(const ArrayInitializer& node, unsigned target) {
+        auto first = top;
+        for (size_t i = 0; i < node.values.size(); ++i) {
+            Temporary();
+        }
+        auto element = first;
+        for (const auto& value : node.values) {
+            Into(value, element++);
+        }
+
+        auto result = Target(target);
+        bool numbers = node.type == root.Symbols()["number"].id;
+        Emit(OpCode::NewArray, result, first, static_cast<unsigned>(node.values.size()), numbers, node.line);
+        return result;
+    }
+
+    static std::string Key(const DotOperation& node) {
+        return std::visit(
+            Visitor{
+                [&](VarID) { return node.scope[node.attribute].name; },
+                [&](const std::string& arg) { return arg; },
+            },
+            node.attribute);
+    }
+
+    // Returns register of a local variable used as a plain value or NoTarget
+    unsigned Local(const Expression& node) const {
+        const auto* ref = std::get_if<VariableRef>(&node.expression);
+        if (!ref || ref->chainedOperation || ref->Symbols()[ref->name].isFunction) {
+            return NoTarget;
+        }
+        auto variable = variables.find(ref->name);
+        return variable != variables.end() ? variable->second : NoTarget;
+    }
+
+    unsigned FieldChain(const Expression& node, std::vector<std::string>& path) const {
+        if (invariants.count(&node)) {
+            return NoTarget;
+        }
+        const auto* ref = std::get_if<VariableRef>(&node.expression);
+        return ref ? FieldChain(*ref, path) : NoTarget;
+    }
+
+    // Returns register of a local variable that is only read through a chain of dot operators
+    // and fills in the keys of the chain, otherwise returns NoTarget
+    unsigned FieldChain(const VariableRef& node, std::vector<std::string>& path) const {
+        if (!options.superinstructions || !node.chainedOperation || node.Symbols()[node.name].isFunction) {
+            return NoTarget;
+        }
+        auto variable = variables.find(node.name);
+        if (variable == variables.end()) {
+            return NoTarget;
+        }
+        for (const ChainedOperation* chain = node.chainedOperation.get(); chain;) {
+            const auto* dot = std::get_if<DotOperation>(&chain->operation);
+            if (!dot || (!std::holds_alternative<std::string>(dot->attribute) && dot->scope[dot->attribute].isFunction)) {
+                return NoTarget;
+            }
+            path.push_back(Key(*dot));
+            chain = dot->chainedOperation.get();
+        }
+        return variable->second;
+    }
+
+    // Finds assignment at the end of a dot and index operation chain
+    static const VariableAssign* Assignment(const ChainedOperation& node) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> const VariableAssign* { return nullptr; },
+                [&](const DotOperation& arg) -> const VariableAssign* {
+                    return arg.chainedOperation ? Assignment(*arg.chainedOperation) : nullptr;
+                },
+                [&](const IndexOperation& arg) -> const VariableAssign* {
+                    return arg.chainedOperation ? Assignment(*arg.chainedOperation) : nullptr;
+                },
+                [&](const VariableAssign& arg) -> const VariableAssign* { return &arg; },
+            },
+            node.operation);
+    }
+
+    static unsigned Layout(Program& program, const ObjectDef& objectDef) {
+        auto it = program.objects.find(objectDef.name);
+        if (it != program.objects.end()) {
+            return static_cast<unsigned>(it->second);
+        }
+
+        std::vector<std::string> keys;
+        for (const auto& attribute : objectDef.attributes) {
+            keys.push_back(objectDef.Symbols()[attribute.name].name);
+        }
+        program.layouts.push_back(std::move(keys));
+        return static_cast<unsigned>(program.objects[objectDef.name] = program.layouts.size() - 1);
+    }
+
+    unsigned Load(const Value& value, unsigned line, unsigned target) {
+        auto result = Target(target);
+        Emit(OpCode::LoadConstant, result, Constant(value), 0, line);
+        return result;
+    }
+
+    unsigned Fail(const std::string& message, unsigned line, unsigned target) {
+        Emit(OpCode::Fail, Constant(Value(message)), 0, 0, line);
+        return Target(target);
+    }
+
+    size_t Emit(OpCode op, unsigned a, unsigned b, unsigned c, unsigned line) {
+        return Emit(op, a, b, c, 0, line);
+    }
+
+    size_t Emit(OpCode op, unsigned a, unsigned b, unsigned c, unsigned d, unsigned line) {
+        function.code.emplace_back(op, a, b, c, d, line);
+        return function.code.size() - 1;
+    }
+
+    unsigned Here() const {
+        return static_cast<unsigned>(function.code.size());
+    }
+
+    unsigned Constant(const Value& value) {
+        for (size_t i = 0; i < function.constants.size(); ++i) {
+            if (function.constants[i].index() == value.index() && function.constants[i] == value) {
+                return static_cast<unsigned>(i);
+            }
+        }
+        function.constants.push_back(value);
+        return static_cast<unsigned>(function.constants.size() - 1);
+    }
+
+    unsigned Path(std::vector<std::string> path) {
+        auto it = std::find(function.paths.begin(), function.paths.end(), path);
+        if (it != function.paths.end()) {
+            return static_cast<unsigned>(it - function.paths.begin());
+        }
+        function.paths.push_back(std::move(path));
+        return static_cast<unsigned>(function.paths.size() - 1);
+    }
+
+    unsigned Target(unsigned target) {
+        return target == NoTarget ? Temporary() : target;
+    }
+
+    unsigned Temporary() {
+        function.registers = std::max(function.registers, top + 1);
+        return top++;
+    }
+
+    unsigned Variable(VarID name) {
+        auto it = variables.find(name);
+        if (it != variables.end()) {
+            return it->second;
+        }
+        auto variable = Temporary();
+        variables.emplace(name, variable);
+        floor = top;
+        return variable;
+    }
+
+    void Release(unsigned saved) {
+        top = std::max(saved, floor);
+    }
+
+    unsigned Reference() {
+        function.references = std::max(function.references, referenceTop + 1);
+        return referenceTop++;
+    }
+};
+
+} // namespace Interpreter
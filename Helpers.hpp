@@ -1,9 +1,17 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
 #include <map>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include "Exceptions.hpp"
 
@@ -19,7 +27,9 @@ struct Object;
 struct Array;
 using VarID = unsigned;
 using VarRef = std::variant<VarID, std::string>;
-using Value = std::variant<std::monostate, bool, double, std::string, Object, Array>;
+// Integral numbers are kept as integers by the virtual machine, numbers visible outside of it are doubles
+using Integer = std::int64_t;
+using Value = std::variant<std::monostate, bool, double, std::string, Object, Array, Integer>;
 
 struct Object {
     Object(std::map<std::string, Value>&& values) : values(std::move(values)) {}
@@ -36,6 +46,7 @@ struct Object {
 
 struct Array {
     Array(std::vector<Value>&& values) : values(std::move(values)) {}
+    Array(std::vector<double>&& numbers) : numbers(std::move(numbers)), packed(true) {}
 
     friend bool operator==(const Array&, const Array&) { throw InternalException("NotImplemented"); }
     friend bool operator!=(const Array&, const Array&) { throw InternalException("NotImplemented"); }
@@ -44,13 +55,132 @@ struct Array {
     friend bool operator>(const Array&, const Array&) { throw InternalException("NotImplemented"); }
     friend bool operator<(const Array&, const Array&) { throw InternalException("NotImplemented"); }
 
+    size_t Size() const { return packed ? numbers.size() : values.size(); }
+
+    // Stores elements as values so elements of other types than numbers can be added
+    void Unpack() {
+        if (packed) {
+            values.assign(numbers.begin(), numbers.end());
+            numbers.clear();
+            packed = false;
+        }
+    }
+
+    // Position of the element at index, Size() when index is not a whole number within bounds
+    size_t Position(const Value& index) const;
+    Value At(size_t position) const;
+    void Set(size_t position, const Value& value);
+    // Amortized constant time, numbers appended to packed or empty arrays stay contiguous
+    void Push(const Value& value);
+
+    // Arrays of numbers keep them contiguously in numbers while values stay empty
     std::vector<Value> values;
+    std::vector<double> numbers;
+    bool packed = false;
 };
 
 using fVoidValuePtr = void(*)(const Value&);
 using fStringPtr = std::string(*)();
 using fDoublePtr = double(*)();
-using ExtFunctionType = std::variant<std::monostate, fVoidValuePtr, fStringPtr, fDoublePtr>;
+using fValuesPtr = Value(*)(const Value* arguments);
+// Function bound with ExternalDefinitions::Bind, arguments are converted straight from the registers of the caller
+using fBound = std::function<Value(const Value* arguments)>;
+using ExtFunctionType = std::variant<std::monostate, fVoidValuePtr, fStringPtr, fDoublePtr, fValuesPtr, fBound>;
+
+// Function provided by the host, registered into global scope next to the predefined functions
+struct ExternalDefinition {
+    std::string signature;
+    ExtFunctionType function;
+};
+struct ExternalDefinitions;
+
+inline bool IsNumber(const Value& value) {
+    return std::holds_alternative<double>(value) || std::holds_alternative<Integer>(value);
+}
+
+inline double ToNumber(const Value& value) {
+    const Integer* integer = std::get_if<Integer>(&value);
+    return integer ? static_cast<double>(*integer) : std::get<double>(value);
+}
+
+inline size_t Array::Position(const Value& index) const {
+    if (!IsNumber(index)) {
+        return Size();
+    }
+    double position = ToNumber(index);
+    if (!(position >= 0 && position < static_cast<double>(Size())) || position != std::floor(position)) {
+        return Size();
+    }
+    return static_cast<size_t>(position);
+}
+
+inline Value Array::At(size_t position) const {
+    return packed ? Value(numbers[position]) : values[position];
+}
+
+inline void Array::Set(size_t position, const Value& value) {
+    if (packed && IsNumber(value)) {
+        numbers[position] = ToNumber(value);
+        return;
+    }
+    Unpack();
+    values[position] = value;
+}
+
+inline void Array::Push(const Value& value) {
+    if (IsNumber(value) && (packed || values.empty())) {
+        numbers.push_back(ToNumber(value));
+        packed = true;
+        return;
+    }
+    Unpack();
+    values.push_back(value);
+}
+
+// Integers are exact up to 2^53 just like doubles, larger results are promoted to double
+constexpr Integer MaxInteger = Integer(1) << 53;
+
+inline Value IntegerResult(Integer result) {
+    if (result > MaxInteger || result < -MaxInteger) {
+        return static_cast<double>(result);
+    }
+    return result;
+}
+
+// Integer representation of the number if it is exact
+inline Value Integral(double value) {
+    if (value >= -static_cast<double>(MaxInteger) && value <= static_cast<double>(MaxInteger) && value == static_cast<double>(static_cast<Integer>(value)) && !(value == 0 && std::signbit(value))) {
+        return static_cast<Integer>(value);
+    }
+    return value;
+}
+
+// Replaces integers by doubles so the representation used by the virtual machine doesn't leak out
+inline void Normalize(Value& value) {
+    std::visit(
+        Visitor{
+            [&](const auto&) {},
+            [&](Integer arg) { value = static_cast<double>(arg); },
+            [&](Object& arg) {
+                for (auto& field : arg.values) {
+                    Normalize(field.second);
+                }
+            },
+            [&](Array& arg) {
+                for (auto& element : arg.values) {
+                    Normalize(element);
+                }
+            },
+        },
+        value);
+}
+
+// Appends the number formatted the same way as by an output stream with default flags
+inline void AppendNumber(std::string& out, double number) {
+    char digits[32];
+    int length = std::snprintf(digits, sizeof(digits), "%g", number);
+    out.append(digits, static_cast<size_t>(length));
+}
 
 // Output operator for Value type
 inline std::ostream& operator<<(std::ostream& os, const Value& val) {
@@ -59,6 +189,7 @@ inline std::ostream& operator<<(std::ostream& os, const Value& val) {
             [&](const auto&) { os << "Void"; },
             [&](bool arg) { os << (arg ? "True" : "False"); },
             [&](double arg) { os << arg; },
+            [&](Integer arg) { os << static_cast<double>(arg); },
             [&](const std::string& arg) { os << "\"" << arg << "\""; },
             [&](const Object& arg) {
                 os << "{ ";
@@ -80,9 +211,14 @@ inline std::string ToString(const Value& val) {
             [&](const auto&) { return "Void"s; },
             [&](bool arg) { return arg ? "True"s : "False"s; },
             [&](double arg) {
-                std::ostringstream oss;
-                oss << arg;
-                return oss.str();
+                std::string result;
+                AppendNumber(result, arg);
+                return result;
+            },
+            [&](Integer arg) {
+                std::string result;
+                AppendNumber(result, static_cast<double>(arg));
+                return result;
             },
             [&](const std::string& arg) { return arg; },
             [&](const Object& arg) {
@@ -94,4 +230,127 @@ inline std::string ToString(const Value& val) {
         val);
 }
 
+// Conversion between a C++ type of a bound function and the script type it is declared with,
+// other arithmetic types are numbers
+template <typename T, typename = void>
+struct Binding;
+
+template <>
+struct Binding<bool> {
+    static constexpr const char* type = "bool";
+    static bool From(const Value& value) {
+        const bool* result = std::get_if<bool>(&value);
+        if (!result) {
+            throw InternalException("Argument must be of type bool.");
+        }
+        return *result;
+    }
+    static Value To(bool value) { return value; }
+};
+
+template <typename T>
+struct Binding<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>> {
+    static constexpr const char* type = "number";
+    static T From(const Value& value) {
+        if (!IsNumber(value)) {
+            throw InternalException("Argument must be of type number.");
+        }
+        double number = ToNumber(value);
+        if constexpr (std::is_integral_v<T>) {
+            // Bounds are powers of two so they are exact as doubles, NaN fails the first check
+            constexpr double lowest = static_cast<double>(std::numeric_limits<T>::min());
+            constexpr double above = static_cast<double>(std::numeric_limits<T>::max() / 2 + 1) * 2;
+            if (std::trunc(number) != number || number < lowest || number >= above) {
+                throw InternalException("Argument " + ToString(number) + " is not an integer the function accepts.");
+            }
+        }
+        return static_cast<T>(number);
+    }
+    static Value To(T value) { return static_cast<double>(value); }
+};
+
+template <>
+struct Binding<std::string> {
+    static constexpr const char* type = "string";
+    static const std::string& From(const Value& value) {
+        const std::string* result = std::get_if<std::string>(&value);
+        if (!result) {
+            throw InternalException("Argument must be of type string.");
+        }
+        return *result;
+    }
+    static Value To(std::string&& value) { return std::move(value); }
+    static Value To(const std::string& value) { return value; }
+};
+
+// Untyped values are copied so integers of the virtual machine don't reach the host
+template <>
+struct Binding<Value> {
+    static constexpr const char* type = nullptr;
+    static Value From(const Value& value) {
+        Value result = value;
+        Normalize(result);
+        return result;
+    }
+    static Value To(Value&& value) { return std::move(value); }
+    static Value To(const Value& value) { return value; }
+};
+
+// Argument of a bound function, const Value& parameters get a normalized copy unless the function
+// reads values in place, as the library does, and then see numbers as either doubles or integers
+template <typename T, bool InPlace>
+decltype(auto) BoundArgument(const Value& value) {
+    if constexpr (InPlace && std::is_same_v<T, const Value&>) {
+        return (value);
+    } else {
+        return Binding<std::decay_t<T>>::From(value);
+    }
+}
+
+template <bool InPlace, typename Result, typename... Args, size_t... Indices>
+Value BoundCall(Result (*function)(Args...), const Value* arguments, std::index_sequence<Indices...>) {
+    if constexpr (std::is_void_v<Result>) {
+        function(BoundArgument<Args, InPlace>(arguments[Indices])...);
+        return Value();
+    } else {
+        return Binding<std::decay_t<Result>>::To(function(BoundArgument<Args, InPlace>(arguments[Indices])...));
+    }
+}
+
+// Wraps a C++ function so it is called with arguments converted from values
+template <bool InPlace = false, typename Result, typename... Args>
+fBound Bound(Result (*function)(Args...)) {
+    return [function](const Value* arguments) { return BoundCall<InPlace>(function, arguments, std::index_sequence_for<Args...>()); };
+}
+
+struct ExternalDefinitions : std::vector<ExternalDefinition> {
+    // Registers a C++ function under name with a signature deduced from its parameter and result
+    // types. Parameters and results of type bool, string and arithmetic types are typed in the
+    // signature, Value ones are untyped and a void result is declared void.
+    template <typename Result, typename... Args>
+    ExternalDefinitions& Bind(const std::string& name, Result (*function)(Args...)) {
+        std::string signature = "func " + name + "(";
+        size_t index = 0;
+        ((signature += Parameter<std::decay_t<Args>>(index++)), ...);
+        signature += ")";
+        if constexpr (std::is_void_v<Result>) {
+            signature += ": void";
+        } else if constexpr (Binding<std::decay_t<Result>>::type != nullptr) {
+            signature += std::string(": ") + Binding<std::decay_t<Result>>::type;
+        }
+        push_back({ signature, Bound(function) });
+        return *this;
+    }
+
+private:
+    template <typename T>
+    static std::string Parameter(size_t index) {
+        std::string parameter = (index ? ", var a" : "var a") + std::to_string(index);
+        if constexpr (Binding<T>::type != nullptr) {
+            parameter += std::string(": ") + Binding<T>::type;
+        }
+        return parameter;
+    }
+};
+
 }
@@ -0,0 +1,624 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Bytecode.hpp"
+
+// Machine code is only generated for x86-64 Linux, other platforms always interpret the bytecode
+#if defined(__x86_64__) && defined(__linux__) && !defined(INTERPRETER_NO_JIT)
+#define INTERPRETER_JIT 1
+#include <sys/mman.h>
+#else
+#define INTERPRETER_JIT 0
+#endif
+
+namespace Interpreter {
+
+// Type of a register at some point of a function. Native code keeps every register as a double,
+// booleans are stored as 0.0 and 1.0.
+enum class NativeType : unsigned char {
+    Unknown,
+    Number,
+    Bool,
+    Conflict,
+};
+
+// Machine code of a function that only works with numbers and booleans. The code is entered with all
+// arguments being numbers and returns either Finished | index of the return instruction that ended it,
+// or index of the instruction the interpreter has to continue from after a call returned something
+// that is not a number.
+class NativeFunction {
+public:
+    static constexpr unsigned Finished = 0x80000000u;
+
+    // Called by the native code for Call and CallExternal instructions with the context it was run with
+    // and index of the instruction. Returns zero when the number result was stored into the register.
+    using CallHandler = int (*)(void* context, unsigned ip);
+
+private:
+    using Entry = unsigned (*)(double* slots, void* context);
+
+    void* memory = nullptr;
+    size_t size = 0;
+    std::vector<std::vector<NativeType>> states;
+
+public:
+    NativeFunction(const NativeFunction&) = delete;
+    NativeFunction& operator=(const NativeFunction&) = delete;
+
+    ~NativeFunction() {
+#if INTERPRETER_JIT
+        if (memory) {
+            munmap(memory, size);
+        }
+#endif
+    }
+
+    unsigned Run(double* slots, void* context) const {
+        return reinterpret_cast<Entry>(memory)(slots, context);
+    }
+
+    // Types of registers before the instruction at ip is executed
+    const std::vector<NativeType>& State(unsigned ip) const {
+        return states[ip];
+    }
+
+    static Value ToValue(double slot, NativeType type) {
+        switch (type) {
+        case NativeType::Number:
+            return slot;
+        case NativeType::Bool:
+            return slot != 0;
+        default:
+            return Value();
+        }
+    }
+
+    // Returns nullptr when the function uses anything besides numbers, booleans and control flow
+    static std::shared_ptr<const NativeFunction> Compile(const CompiledFunction& function, const Program& program, CallHandler call) {
+#if INTERPRETER_JIT
+        std::shared_ptr<NativeFunction> native(new NativeFunction());
+        if (!native->Analyze(function, program)) {
+            return nullptr;
+        }
+
+        auto code = Assembler(function, call).Assemble();
+        native->size = code.size();
+        native->memory = mmap(nullptr, native->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (native->memory == MAP_FAILED) {
+            native->memory = nullptr;
+            return nullptr;
+        }
+        std::memcpy(native->memory, code.data(), code.size());
+        if (mprotect(native->memory, native->size, PROT_READ | PROT_EXEC) != 0) {
+            return nullptr;
+        }
+        return native;
+#else
+        (void)function;
+        (void)program;
+        (void)call;
+        return nullptr;
+#endif
+    }
+
+private:
+    NativeFunction() = default;
+
+    // Computes types of all registers before every instruction, arguments are guarded to be numbers
+    bool Analyze(const CompiledFunction& function, const Program& program) {
+        const auto& code = function.code;
+        states.assign(code.size(), std::vector<NativeType>(function.registers, NativeType::Unknown));
+        std::vector<char> reached(code.size());
+        if (code.empty()) {
+            return false;
+        }
+        for (unsigned i = 0; i < function.arguments; ++i) {
+            states[0][i] = NativeType::Number;
+        }
+
+        std::vector<unsigned> pending = { 0 };
+        reached[0] = true;
+        while (!pending.empty()) {
+            unsigned ip = pending.back();
+            pending.pop_back();
+
+            const Instruction& instruction = code[ip];
+            std::vector<NativeType> state = states[ip];
+            if (!Transfer(instruction, function, state)) {
+                return false;
+            }
+
+            auto flow = [&](unsigned target) {
+                if (target >= code.size()) {
+                    return;
+                }
+                bool changed = !reached[target];
+                reached[target] = true;
+                for (size_t i = 0; i < state.size(); ++i) {
+                    auto merged = Merge(states[target][i], state[i]);
+                    changed |= merged != states[target][i];
+                    states[target][i] = merged;
+                }
+                if (changed) {
+                    pending.push_back(target);
+                }
+            };
+            switch (instruction.op) {
+            case OpCode::Jump:
+                flow(instruction.a);
+                break;
+            case OpCode::JumpIfFalse:
+            case OpCode::JumpIfTrue:
+            case OpCode::ForTest:
+            case OpCode::ForLoop:
+                flow(instruction.b);
+                flow(ip + 1);
+                break;
+            case OpCode::TailCall:
+                flow(0);
+                break;
+            case OpCode::Return:
+            case OpCode::ReturnVoid:
+                break;
+            default:
+                flow(ip + 1);
+                break;
+            }
+        }
+
+        for (unsigned ip = 0; ip < code.size(); ++ip) {
+            if (reached[ip] && !Check(code[ip], function, program, states[ip])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static NativeType Merge(NativeType lhs, NativeType rhs) {
+        if (lhs == NativeType::Unknown || lhs == rhs) {
+            return rhs;
+        }
+        return rhs == NativeType::Unknown ? lhs : NativeType::Conflict;
+    }
+
+    static NativeType ConstantType(const Value& value) {
+        if (IsNumber(value)) {
+            return NativeType::Number;
+        }
+        return std::holds_alternative<bool>(value) ? NativeType::Bool : NativeType::Conflict;
+    }
+
+    // Applies writes of the instruction to the state, fails on unsupported instructions
+    static bool Transfer(const Instruction& instruction, const CompiledFunction& function, std::vector<NativeType>& state) {
+        switch (Generic(instruction.op)) {
+        case OpCode::LoadConstant:
+            state[instruction.a] = ConstantType(function.constants[instruction.b]);
+            return state[instruction.a] != NativeType::Conflict;
+        case OpCode::Move:
+            state[instruction.a] = state[instruction.b];
+            return true;
+        case OpCode::Add:
+        case OpCode::Subtract:
+        case OpCode::Multiply:
+        case OpCode::Divide:
+        case OpCode::AddConstant:
+        case OpCode::SubtractConstant:
+        case OpCode::Increment:
+        case OpCode::Decrement:
+        case OpCode::Call:
+        case OpCode::CallExternal:
+            state[instruction.a] = NativeType::Number;
+            return true;
+        case OpCode::Equal:
+        case OpCode::NotEqual:
+        case OpCode::Less:
+        case OpCode::LessEqual:
+        case OpCode::Greater:
+        case OpCode::GreaterEqual:
+        case OpCode::And:
+        case OpCode::Or:
+        case OpCode::Not:
+            state[instruction.a] = NativeType::Bool;
+            return true;
+        case OpCode::ForPrepare:
+            state[instruction.a + 1] = NativeType::Number;
+            state[instruction.a + 2] = NativeType::Number;
+            return true;
+        case OpCode::ForStep:
+            state[instruction.a] = NativeType::Number;
+            return true;
+        case OpCode::ForLoop:
+            state[instruction.a] = NativeType::Number;
+            state[instruction.c] = NativeType::Number;
+            return true;
+        case OpCode::TailCall:
+            for (unsigned i = 0; i < function.arguments; ++i) {
+                state[i] = NativeType::Number;
+            }
+            return true;
+        case OpCode::Jump:
+        case OpCode::JumpIfFalse:
+        case OpCode::JumpIfTrue:
+        case OpCode::ForTest:
+        case OpCode::Return:
+        case OpCode::ReturnVoid:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Verifies that the instruction reads registers of the types native code expects
+    static bool Check(const Instruction& instruction, const CompiledFunction& function, const Program& program, const std::vector<NativeType>& state) {
+        auto is = [&](unsigned reg, NativeType type) { return state[reg] == type; };
+        auto number = [&](unsigned reg) { return is(reg, NativeType::Number); };
+        auto boolean = [&](unsigned reg) { return is(reg, NativeType::Bool); };
+        switch (Generic(instruction.op)) {
+        case OpCode::Add:
+        case OpCode::Subtract:
+        case OpCode::Multiply:
+        case OpCode::Divide:
+        case OpCode::Less:
+        case OpCode::LessEqual:
+        case OpCode::Greater:
+        case OpCode::GreaterEqual:
+            return number(instruction.b) && number(instruction.c);
+        case OpCode::AddConstant:
+        case OpCode::SubtractConstant:
+            return number(instruction.b) && IsNumber(function.constants[instruction.c]);
+        case OpCode::Increment:
+        case OpCode::Decrement:
+            return number(instruction.b);
+        case OpCode::Equal:
+        case OpCode::NotEqual:
+            return (number(instruction.b) || boolean(instruction.b)) && state[instruction.b] == state[instruction.c];
+        case OpCode::And:
+        case OpCode::Or:
+            return boolean(instruction.b) && boolean(instruction.c);
+        case OpCode::Not:
+            return boolean(instruction.b);
+        case OpCode::JumpIfFalse:
+        case OpCode::JumpIfTrue:
+            return boolean(instruction.a);
+        case OpCode::ForPrepare:
+            return number(instruction.a) && number(instruction.a + 1);
+        case OpCode::ForTest:
+        case OpCode::ForStep:
+        case OpCode::ForLoop:
+            return number(instruction.a) && number(instruction.a + 1) && number(instruction.a + 2);
+        case OpCode::Call:
+        case OpCode::CallExternal:
+            for (unsigned i = 0; i < program.functions[instruction.b].arguments; ++i) {
+                if (!number(instruction.c + i) && !boolean(instruction.c + i)) {
+                    return false;
+                }
+            }
+            return true;
+        case OpCode::Return:
+            return number(instruction.a) || boolean(instruction.a);
+        // Only calls of the function itself become a jump to its start, arguments are expected to be numbers there
+        case OpCode::TailCall:
+            if (&program.functions[instruction.b] != &function) {
+                return false;
+            }
+            for (unsigned i = 0; i < function.arguments; ++i) {
+                if (!number(instruction.c + i)) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return true;
+        }
+    }
+
+#if INTERPRETER_JIT
+    // Translates every instruction into a fixed template of machine code. Registers live in memory
+    // addressed by rbx, the context of the run is kept in r12.
+    class Assembler {
+        const CompiledFunction& function;
+        CallHandler call;
+        std::vector<unsigned char> code;
+        std::vector<size_t> labels;
+        std::vector<std::pair<size_t, unsigned>> fixups;
+
+    public:
+        Assembler(const CompiledFunction& function, CallHandler call)
+            : function(function), call(call) {}
+
+        std::vector<unsigned char> Assemble() {
+            // push rbx; push r12; push rbp; mov rbx, rdi; mov r12, rsi
+            Bytes({ 0x53, 0x41, 0x54, 0x55, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4 });
+            for (unsigned ip = 0; ip < function.code.size(); ++ip) {
+                labels.push_back(code.size());
+                Translate(function.code[ip], ip);
+            }
+
+            // Epilogue is the target of all returns and bailouts, status is already in eax
+            labels.push_back(code.size());
+            Bytes({ 0x5D, 0x41, 0x5C, 0x5B, 0xC3 });
+
+            for (const auto& [at, target] : fixups) {
+                Patch32(at, labels[target]);
+            }
+            return std::move(code);
+        }
+
+    private:
+        unsigned Epilogue() const {
+            return static_cast<unsigned>(function.code.size());
+        }
+
+        void Translate(const Instruction& instruction, unsigned ip) {
+            const unsigned a = instruction.a;
+            const unsigned b = instruction.b;
+            const unsigned c = instruction.c;
+            const OpCode op = Generic(instruction.op);
+            switch (op) {
+            case OpCode::LoadConstant: {
+                const Value& constant = function.constants[b];
+                LoadImmediate(IsNumber(constant) ? ToNumber(constant) : std::get<bool>(constant) ? 1.0 : 0.0);
+                StoreRax(a);
+                break;
+            }
+            case OpCode::Move:
+                LoadRax(b);
+                StoreRax(a);
+                break;
+            case OpCode::Add:
+            case OpCode::Subtract:
+            case OpCode::Multiply:
+            case OpCode::Divide:
+                LoadXmm(0, b);
+                Arithmetic(op, c);
+                StoreXmm(0, a);
+                break;
+            case OpCode::AddConstant:
+            case OpCode::SubtractConstant:
+            case OpCode::Increment:
+            case OpCode::Decrement: {
+                double constant = instruction.op == OpCode::Increment ? 1.0 : instruction.op == OpCode::Decrement ? -1.0 : ToNumber(function.constants[c]);
+                LoadXmm(0, b);
+                LoadImmediate(constant);
+                Bytes({ 0x66, 0x48, 0x0F, 0x6E, 0xC8 }); // movq xmm1, rax
+                Bytes({ 0xF2, 0x0F, static_cast<unsigned char>(instruction.op == OpCode::SubtractConstant ? 0x5C : 0x58), 0xC1 });
+                StoreXmm(0, a);
+                break;
+            }
+            case OpCode::Less:
+            case OpCode::LessEqual:
+                // b < c is evaluated as c > b so unordered operands give false
+                LoadXmm(0, c);
+                Memory({ 0x66, 0x0F, 0x2E }, 0, b); // ucomisd xmm0, [b]
+                Bytes({ 0x0F, static_cast<unsigned char>(op == OpCode::Less ? 0x97 : 0x93), 0xC0 }); // seta/setae al
+                StoreFlag(a);
+                break;
+            case OpCode::Greater:
+            case OpCode::GreaterEqual:
+                LoadXmm(0, b);
+                Memory({ 0x66, 0x0F, 0x2E }, 0, c);
+                Bytes({ 0x0F, static_cast<unsigned char>(op == OpCode::Greater ? 0x97 : 0x93), 0xC0 });
+                StoreFlag(a);
+                break;
+            case OpCode::Equal:
+                LoadXmm(0, b);
+                Memory({ 0x66, 0x0F, 0x2E }, 0, c);
+                Bytes({ 0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8 }); // sete al; setnp cl; and al, cl
+                StoreFlag(a);
+                break;
+            case OpCode::NotEqual:
+                LoadXmm(0, b);
+                Memory({ 0x66, 0x0F, 0x2E }, 0, c);
+                Bytes({ 0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8 }); // setne al; setp cl; or al, cl
+                StoreFlag(a);
+                break;
+            case OpCode::And:
+            case OpCode::Or:
+                // Bit patterns of 0.0 and 1.0 combine like the booleans they represent
+                LoadXmm(0, b);
+                LoadXmm(1, c);
+                Bytes({ 0x66, 0x0F, static_cast<unsigned char>(instruction.op == OpCode::And ? 0x54 : 0x56), 0xC1 });
+                StoreXmm(0, a);
+                break;
+            case OpCode::Not:
+                LoadXmm(0, b);
+                LoadImmediate(1.0);
+                Bytes({ 0x66, 0x48, 0x0F, 0x6E, 0xC8 }); // movq xmm1, rax
+                Bytes({ 0x66, 0x0F, 0x57, 0xC1 });       // xorpd xmm0, xmm1
+                StoreXmm(0, a);
+                break;
+            case OpCode::Jump:
+                Jump(a);
+                break;
+            case OpCode::JumpIfFalse:
+            case OpCode::JumpIfTrue:
+                Memory({ 0x48, 0x83 }, 7, a); // cmp qword [a], 0
+                Bytes({ 0x00 });
+                Branch(instruction.op == OpCode::JumpIfFalse ? 0x84 : 0x85, b);
+                break;
+            case OpCode::ForPrepare: {
+                // step = from < to ? 1 : -1, limit = include last ? to + step : to
+                LoadXmm(0, a + 1);
+                Memory({ 0x66, 0x0F, 0x2E }, 0, a); // ucomisd xmm0, [from]
+                LoadImmediate(1.0);
+                auto positive = Short(0x77); // ja
+                LoadImmediate(-1.0);
+                Land(positive);
+                StoreRax(a + 2);
+                if (b) {
+                    Bytes({ 0x66, 0x48, 0x0F, 0x6E, 0xC8 }); // movq xmm1, rax
+                    Bytes({ 0xF2, 0x0F, 0x58, 0xC1 });       // addsd xmm0, xmm1
+                    StoreXmm(0, a + 1);
+                }
+                break;
+            }
+            case OpCode::ForTest: {
+                LoadXmm(0, a);
+                LoadXmm(1, a + 1);
+                LoadRax(a + 2);
+                Bytes({ 0x48, 0x85, 0xC0 }); // test rax, rax
+                auto negative = Short(0x78); // js
+                Bytes({ 0x66, 0x0F, 0x2E, 0xC1 }); // ucomisd xmm0, xmm1
+                Branch(0x83, b);                   // jae exit
+                auto end = Short(0xEB);
+                Land(negative);
+                Bytes({ 0x66, 0x0F, 0x2E, 0xC8 }); // ucomisd xmm1, xmm0
+                Branch(0x83, b);
+                Land(end);
+                break;
+            }
+            case OpCode::ForStep:
+                LoadXmm(0, a);
+                Arithmetic(OpCode::Add, a + 2);
+                StoreXmm(0, a);
+                break;
+            case OpCode::ForLoop: {
+                LoadXmm(0, a);
+                Arithmetic(OpCode::Add, a + 2);
+                StoreXmm(0, a);
+                LoadXmm(1, a + 1);
+                LoadRax(a + 2);
+                Bytes({ 0x48, 0x85, 0xC0 }); // test rax, rax
+                auto negative = Short(0x78); // js
+                Bytes({ 0x66, 0x0F, 0x2E, 0xC8 }); // ucomisd xmm1, xmm0
+                auto continuePositive = Short(0x77); // ja
+                auto exitPositive = Short(0xEB);
+                Land(negative);
+                Bytes({ 0x66, 0x0F, 0x2E, 0xC1 }); // ucomisd xmm0, xmm1
+                auto exitNegative = Short(0x76);   // jbe
+                Land(continuePositive);
+                StoreXmm(0, c);
+                Jump(b);
+                Land(exitPositive);
+                Land(exitNegative);
+                break;
+            }
+            case OpCode::Call:
+            case OpCode::CallExternal: {
+                Bytes({ 0x4C, 0x89, 0xE7 }); // mov rdi, r12
+                Bytes({ 0xBE });             // mov esi, ip
+                Bytes32(ip);
+                Bytes({ 0x48, 0xB8 }); // mov rax, call
+                Bytes64(reinterpret_cast<std::uintptr_t>(call));
+                Bytes({ 0xFF, 0xD0, 0x85, 0xC0 }); // call rax; test eax, eax
+                auto done = Short(0x74);           // jz
+                Status(ip + 1);
+                Land(done);
+                break;
+            }
+            case OpCode::TailCall:
+                for (unsigned i = 0; i < function.arguments; ++i) {
+                    LoadRax(c + i);
+                    StoreRax(i);
+                }
+                Jump(0);
+                break;
+            case OpCode::Return:
+            case OpCode::ReturnVoid:
+                Status(Finished | ip);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Leaves the function with status in eax
+        void Status(unsigned status) {
+            Bytes({ 0xB8 });
+            Bytes32(status);
+            Jump(Epilogue());
+        }
+
+        void Arithmetic(OpCode op, unsigned reg) {
+            unsigned char opcode = op == OpCode::Add ? 0x58 : op == OpCode::Subtract ? 0x5C : op == OpCode::Multiply ? 0x59 : 0x5E;
+            Memory({ 0xF2, 0x0F, opcode }, 0, reg);
+        }
+
+        void LoadXmm(unsigned xmm, unsigned reg) {
+            Memory({ 0xF2, 0x0F, 0x10 }, xmm, reg);
+        }
+
+        void StoreXmm(unsigned xmm, unsigned reg) {
+            Memory({ 0xF2, 0x0F, 0x11 }, xmm, reg);
+        }
+
+        void LoadRax(unsigned reg) {
+            Memory({ 0x48, 0x8B }, 0, reg);
+        }
+
+        void StoreRax(unsigned reg) {
+            Memory({ 0x48, 0x89 }, 0, reg);
+        }
+
+        void LoadImmediate(double value) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            Bytes({ 0x48, 0xB8 }); // mov rax, imm64
+            Bytes64(bits);
+        }
+
+        // Converts flag in al to 0.0 or 1.0 and stores it into register
+        void StoreFlag(unsigned reg) {
+            Bytes({ 0x0F, 0xB6, 0xC0 });       // movzx eax, al
+            Bytes({ 0xF2, 0x0F, 0x2A, 0xC0 }); // cvtsi2sd xmm0, eax
+            StoreXmm(0, reg);
+        }
+
+        // Instruction with [rbx + 8 * reg] memory operand
+        void Memory(std::initializer_list<unsigned char> opcode, unsigned field, unsigned reg) {
+            Bytes(opcode);
+            Bytes({ static_cast<unsigned char>(0x83 | (field << 3)) });
+            Bytes32(8 * reg);
+        }
+
+        void Jump(unsigned target) {
+            Bytes({ 0xE9 });
+            fixups.emplace_back(code.size(), target);
+            Bytes32(0);
+        }
+
+        void Branch(unsigned char condition, unsigned target) {
+            Bytes({ 0x0F, condition });
+            fixups.emplace_back(code.size(), target);
+            Bytes32(0);
+        }
+
+        // Forward jump within a template, resolved by Land
+        size_t Short(unsigned char opcode) {
+            Bytes({ opcode, 0x00 });
+            return code.size();
+        }
+
+        void Land(size_t jump) {
+            code[jump - 1] = static_cast<unsigned char>(code.size() - jump);
+        }
+
+        void Patch32(size_t at, size_t target) {
+            auto offset = static_cast<std::int32_t>(static_cast<std::int64_t>(target) - static_cast<std::int64_t>(at + 4));
+            std::memcpy(&code[at], &offset, sizeof(offset));
+        }
+
+        void Bytes(std::initializer_list<unsigned char> bytes) {
+            code.insert(code.end(), bytes);
+        }
+
+        void Bytes32(std::uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                code.push_back(static_cast<unsigned char>(value >> (8 * i)));
+            }
+        }
+
+        void Bytes64(std::uint64_t value) {
+            for (int i = 0; i < 8; ++i) {
+                code.push_back(static_cast<unsigned char>(value >> (8 * i)));
+            }
+        }
+    };
+#endif
+};
+
+} // namespace Interpreter
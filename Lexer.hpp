@@ -45,6 +45,8 @@ class Lexer {
         std::make_pair("null", Token::Type::Null), std::make_pair("var", Token::Type::Var),
         std::make_pair("true", Token::Type::True), std::make_pair("false", Token::Type::False),
         std::make_pair("object", Token::Type::Object), std::make_pair("new", Token::Type::New),
+        std::make_pair("parallel", Token::Type::Parallel), std::make_pair("spawn", Token::Type::UnaryOperator),
+        std::make_pair("await", Token::Type::UnaryOperator), std::make_pair("yield", Token::Type::UnaryOperator),
     };
 
 public:
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Helpers.hpp"
+
+// Predefined string and math functions, found by names the script doesn't define.
+// Strings are read in place from the registers of the caller, only results are allocated.
+namespace Interpreter::Library {
+
+// Position within text of size characters, fractions are dropped and positions out of the text
+// are clamped to its bounds
+inline size_t Position(double position, size_t size) {
+    if (!(position > 0)) {
+        return 0;
+    }
+    return position >= static_cast<double>(size) ? size : static_cast<size_t>(position);
+}
+
+// Count of characters of a text or of elements of an array
+inline double Length(const Value& value) {
+    if (const std::string* text = std::get_if<std::string>(&value)) {
+        return static_cast<double>(text->size());
+    }
+    if (const Array* array = std::get_if<Array>(&value)) {
+        return static_cast<double>(array->Size());
+    }
+    throw InternalException("Length expects a text or an array.");
+}
+
+inline std::string Substring(const std::string& text, double start, double count) {
+    size_t from = Position(start, text.size());
+    return text.substr(from, Position(count, text.size() - from));
+}
+
+// Position of the first occurrence of pattern, -1 when there is none
+inline double Find(const std::string& text, const std::string& pattern) {
+    size_t position = text.find(pattern);
+    return position == std::string::npos ? -1 : static_cast<double>(position);
+}
+
+// Parts of text between separators, an empty separator splits text into single characters
+inline Value Split(const std::string& text, const std::string& separator) {
+    std::vector<Value> parts;
+    if (separator.empty()) {
+        for (char character : text) {
+            parts.emplace_back(std::string(1, character));
+        }
+        return Array(std::move(parts));
+    }
+
+    size_t start = 0;
+    for (size_t end; (end = text.find(separator, start)) != std::string::npos; start = end + separator.size()) {
+        parts.emplace_back(text.substr(start, end - start));
+    }
+    parts.emplace_back(text.substr(start));
+    return Array(std::move(parts));
+}
+
+inline std::string Join(const Value& values, const std::string& separator) {
+    const Array* array = std::get_if<Array>(&values);
+    if (!array) {
+        throw InternalException("Join expects an array.");
+    }
+
+    std::string result;
+    for (size_t i = 0; i < array->Size(); ++i) {
+        if (i) {
+            result += separator;
+        }
+        if (array->packed) {
+            AppendNumber(result, array->numbers[i]);
+            continue;
+        }
+        const Value& value = array->values[i];
+        if (const std::string* text = std::get_if<std::string>(&value)) {
+            result += *text;
+        } else if (IsNumber(value)) {
+            AppendNumber(result, ToNumber(value));
+        } else {
+            result += ToString(value);
+        }
+    }
+    return result;
+}
+
+inline double Floor(double value) {
+    return std::floor(value);
+}
+
+inline double Sqrt(double value) {
+    return std::sqrt(value);
+}
+
+inline double Pow(double base, double exponent) {
+    return std::pow(base, exponent);
+}
+
+inline double Min(double lhs, double rhs) {
+    return std::min(lhs, rhs);
+}
+
+inline double Max(double lhs, double rhs) {
+    return std::max(lhs, rhs);
+}
+
+// Copy of the array with value added at its end, data = Append(data, value) is compiled into an
+// append in place
+inline Value Append(const Value& values, const Value& value) {
+    const Array* array = std::get_if<Array>(&values);
+    if (!array) {
+        throw InternalException("Append expects an array.");
+    }
+    Array result = *array;
+    result.Push(value);
+    return result;
+}
+
+// Number with fixed count of decimal places
+inline std::string Format(double value, double decimals) {
+    int precision = static_cast<int>(Position(decimals, 64));
+    int length = std::snprintf(nullptr, 0, "%.*f", precision, value);
+    std::string result(static_cast<size_t>(length), '\0');
+    std::snprintf(result.data(), result.size() + 1, "%.*f", precision, value);
+    return result;
+}
+
+// Elements of an array of numbers, arrays that keep values are converted into scratch
+inline const std::vector<double>& Numbers(const Value& values, std::vector<double>& scratch) {
+    const Array* array = std::get_if<Array>(&values);
+    if (!array) {
+        throw InternalException("Expected an array of numbers.");
+    }
+    if (array->packed) {
+        return array->numbers;
+    }
+    scratch.resize(array->values.size());
+    for (size_t i = 0; i < scratch.size(); ++i) {
+        if (!IsNumber(array->values[i])) {
+            throw InternalException("Expected an array of numbers.");
+        }
+        scratch[i] = ToNumber(array->values[i]);
+    }
+    return scratch;
+}
+
+// Reductions run in four independent lanes, so additions don't wait on a single accumulator and
+// the compiler can keep the lanes in vector registers. Sums may differ from a sequential sum in
+// the last bits.
+template <typename Operation>
+double Reduce(const std::vector<double>& numbers, double initial, Operation operation) {
+    double lanes[4] = { initial, initial, initial, initial };
+    size_t i = 0;
+    for (; i + 4 <= numbers.size(); i += 4) {
+        lanes[0] = operation(lanes[0], numbers[i]);
+        lanes[1] = operation(lanes[1], numbers[i + 1]);
+        lanes[2] = operation(lanes[2], numbers[i + 2]);
+        lanes[3] = operation(lanes[3], numbers[i + 3]);
+    }
+    double result = operation(operation(lanes[0], lanes[1]), operation(lanes[2], lanes[3]));
+    for (; i < numbers.size(); ++i) {
+        result = operation(result, numbers[i]);
+    }
+    return result;
+}
+
+inline double Total(const Value& values) {
+    std::vector<double> scratch;
+    return Reduce(Numbers(values, scratch), 0.0, [](double lhs, double rhs) { return lhs + rhs; });
+}
+
+inline double Minimum(const Value& values) {
+    std::vector<double> scratch;
+    const auto& numbers = Numbers(values, scratch);
+    if (numbers.empty()) {
+        throw InternalException("Minimum of an empty array.");
+    }
+    return Reduce(numbers, numbers[0], [](double lhs, double rhs) { return rhs < lhs ? rhs : lhs; });
+}
+
+inline double Maximum(const Value& values) {
+    std::vector<double> scratch;
+    const auto& numbers = Numbers(values, scratch);
+    if (numbers.empty()) {
+        throw InternalException("Maximum of an empty array.");
+    }
+    return Reduce(numbers, numbers[0], [](double lhs, double rhs) { return rhs > lhs ? rhs : lhs; });
+}
+
+inline double Dot(const Value& lhs, const Value& rhs) {
+    std::vector<double> lhsScratch;
+    std::vector<double> rhsScratch;
+    const auto& lhsNumbers = Numbers(lhs, lhsScratch);
+    const auto& rhsNumbers = Numbers(rhs, rhsScratch);
+    if (lhsNumbers.size() != rhsNumbers.size()) {
+        throw InternalException("Dot product of arrays of different lengths.");
+    }
+
+    double lanes[4] = {};
+    size_t i = 0;
+    for (; i + 4 <= lhsNumbers.size(); i += 4) {
+        lanes[0] += lhsNumbers[i] * rhsNumbers[i];
+        lanes[1] += lhsNumbers[i + 1] * rhsNumbers[i + 1];
+        lanes[2] += lhsNumbers[i + 2] * rhsNumbers[i + 2];
+        lanes[3] += lhsNumbers[i + 3] * rhsNumbers[i + 3];
+    }
+    double result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < lhsNumbers.size(); ++i) {
+        result += lhsNumbers[i] * rhsNumbers[i];
+    }
+    return result;
+}
+
+// Array of numbers with every element multiplied by factor
+inline Value Scaled(const Value& values, double factor) {
+    std::vector<double> scratch;
+    const auto& numbers = Numbers(values, scratch);
+    std::vector<double> result(numbers.size());
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        result[i] = numbers[i] * factor;
+    }
+    return Array(std::move(result));
+}
+
+} // namespace Interpreter::Library
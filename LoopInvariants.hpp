@@ -0,0 +1,224 @@
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "Ast.hpp"
+
+namespace Interpreter {
+
+// Finds expressions of a loop that yield the same value on every iteration so they can be computed
+// once before the loop. Only operators and reads of fields through dot operators of variables that
+// the loop never assigns are invariant, function calls are not.
+//
+// Expressions are taken only from the part of an iteration that is always evaluated before the first
+// function call or return, so computing them ahead neither skips nor reorders observable effects.
+class LoopInvariants {
+    std::set<VarID> assigned;
+    std::vector<const Expression*> invariants;
+    bool collecting = false;
+    bool stopped = false;
+
+    LoopInvariants() = default;
+
+public:
+    static std::vector<const Expression*> Find(const WhileExpr& node) {
+        LoopInvariants loop;
+        loop.Visit(*node.condition, false);
+        loop.Visit(*node.block, false);
+
+        loop.collecting = true;
+        loop.stopped = false;
+        if (node.isDoWhile) {
+            loop.Visit(*node.block, true);
+            loop.Visit(*node.condition, true);
+        } else {
+            loop.Visit(*node.condition, true);
+            loop.Visit(*node.block, true);
+        }
+        return std::move(loop.invariants);
+    }
+
+    static std::vector<const Expression*> Find(const ForExpr& node) {
+        LoopInvariants loop;
+        loop.assigned.insert(node.controlVariable->name);
+        loop.Visit(*node.block, false);
+
+        loop.collecting = true;
+        loop.stopped = false;
+        loop.Visit(*node.block, true);
+        return std::move(loop.invariants);
+    }
+
+private:
+    void Visit(const Block& node, bool always) {
+        for (const auto& statement : node.statements) {
+            Visit(statement, always);
+        }
+    }
+
+    void Visit(const Statement& node, bool always) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const Return& arg) {
+                    if (arg.value) {
+                        Visit(*arg.value, always);
+                    }
+                    stopped = true;
+                },
+                [&](const ForExpr& arg) {
+                    assigned.insert(arg.controlVariable->name);
+                    Visit(*arg.range->from, always);
+                    if (arg.range->to) {
+                        Visit(*arg.range->to, always);
+                    }
+                    Visit(*arg.block, false);
+                },
+                [&](const IfExpr& arg) {
+                    Visit(*arg.ifStatement->condition, always);
+                    Visit(*arg.ifStatement->block, false);
+                    for (const auto& elseif : arg.elseifStatements) {
+                        Visit(*elseif.condition, false);
+                        Visit(*elseif.block, false);
+                    }
+                    if (arg.elseStatement) {
+                        Visit(*arg.elseStatement->block, false);
+                    }
+                },
+                [&](const WhileExpr& arg) {
+                    Visit(*arg.condition, always && !arg.isDoWhile);
+                    Visit(*arg.block, false);
+                    if (arg.isDoWhile) {
+                        Visit(*arg.condition, false);
+                    }
+                },
+                [&](const Expression& arg) { Visit(arg, always); },
+            },
+            node.expression);
+    }
+
+    void Visit(const Expression& node, bool always) {
+        if (collecting && always && !stopped && Hoistable(node)) {
+            invariants.push_back(&node);
+            return;
+        }
+
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const UnaryOperation& arg) { Visit(*arg.value, always); },
+                [&](const BinaryOperation& arg) {
+                    Visit(*arg.lhs, always);
+                    Visit(*arg.rhs, always);
+                },
+                [&](const VariableRef& arg) {
+                    if (arg.chainedOperation) {
+                        if (Assignment(*arg.chainedOperation)) {
+                            assigned.insert(arg.name);
+                        }
+                        Visit(*arg.chainedOperation, always);
+                    }
+                },
+                [&](const VariableDef& arg) {
+                    assigned.insert(arg.name);
+                    if (arg.value) {
+                        Visit(*arg.value, always);
+                    }
+                },
+                // Attributes are evaluated in the order of the object definition
+                [&](const ObjectInitializer& arg) {
+                    for (const auto& value : arg.values) {
+                        Visit(value.second, false);
+                    }
+                },
+                [&](const ArrayInitializer& arg) {
+                    for (const auto& value : arg.values) {
+                        Visit(value, always);
+                    }
+                },
+            },
+            node.expression);
+    }
+
+    void Visit(const ChainedOperation& node, bool always) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const DotOperation& arg) {
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation, always);
+                    }
+                },
+                [&](const IndexOperation& arg) {
+                    Visit(*arg.index, always);
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation, always);
+                    }
+                },
+                [&](const VariableAssign& arg) { Visit(*arg.value, always); },
+                [&](const FunctionCall& arg) {
+                    for (const auto& argument : arg.arguments) {
+                        Visit(argument, always);
+                    }
+                    stopped = true;
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation, always);
+                    }
+                },
+            },
+            node.operation);
+    }
+
+    // Invariant expressions that are worth computing ahead, literals and variables already are
+    bool Hoistable(const Expression& node) const {
+        if (const auto* ref = std::get_if<VariableRef>(&node.expression)) {
+            return ref->chainedOperation && Invariant(node);
+        }
+        return (std::holds_alternative<UnaryOperation>(node.expression) || std::holds_alternative<BinaryOperation>(node.expression)) && Invariant(node);
+    }
+
+    bool Invariant(const Expression& node) const {
+        static const std::set<std::string> operators = { "!", "++", "--", "==", "!=", "<", "<=", ">", ">=", "+", "-", "*", "/", "&&", "||" };
+        return std::visit(
+            Visitor{
+                [&](const auto&) { return false; },
+                [&](bool) { return true; },
+                [&](double) { return true; },
+                [&](const std::string&) { return true; },
+                [&](const UnaryOperation& arg) { return operators.count(arg.operation) && Invariant(*arg.value); },
+                [&](const BinaryOperation& arg) { return operators.count(arg.operation) && Invariant(*arg.lhs) && Invariant(*arg.rhs); },
+                [&](const VariableRef& arg) {
+                    if (arg.Symbols()[arg.name].isFunction || assigned.count(arg.name)) {
+                        return false;
+                    }
+                    for (const ChainedOperation* chain = arg.chainedOperation.get(); chain;) {
+                        const auto* dot = std::get_if<DotOperation>(&chain->operation);
+                        if (!dot || (!std::holds_alternative<std::string>(dot->attribute) && dot->scope[dot->attribute].isFunction)) {
+                            return false;
+                        }
+                        chain = dot->chainedOperation.get();
+                    }
+                    return true;
+                },
+            },
+            node.expression);
+    }
+
+    static const VariableAssign* Assignment(const ChainedOperation& node) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> const VariableAssign* { return nullptr; },
+                [&](const DotOperation& arg) -> const VariableAssign* {
+                    return arg.chainedOperation ? Assignment(*arg.chainedOperation) : nullptr;
+                },
+                [&](const IndexOperation& arg) -> const VariableAssign* {
+                    return arg.chainedOperation ? Assignment(*arg.chainedOperation) : nullptr;
+                },
+                [&](const VariableAssign& arg) -> const VariableAssign* { return &arg; },
+            },
+            node.operation);
+    }
+};
+
+} // namespace Interpreter
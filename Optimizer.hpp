@@ -0,0 +1,537 @@
+#pragma once
+
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Ast.hpp"
+#include "ValueOperators.hpp"
+
+namespace Interpreter {
+
+// Rewrites the typechecked tree before compilation. Operations on literals are folded, identities
+// on plain variables are simplified, branches and loops with constant conditions and statements
+// after a return are pruned and definitions unreachable from the entry functions are dropped.
+class Optimizer {
+    const Global& root;
+
+    // Definitions found reachable and functions whose bodies are still to be searched
+    std::set<VarID> reachable;
+    std::vector<const FunctionDef*> pending;
+
+    Optimizer(const Global& root)
+        : root(root) {}
+
+public:
+    static void Optimize(Global& root) {
+        Optimizer optimizer(root);
+        for (auto& definition : root.definitions) {
+            std::visit(
+                Visitor{
+                    [&](FunctionDef& arg) {
+                        // Bodies that are not parsed yet are optimized once they are
+                        if (arg.block) {
+                            optimizer.Optimize(*arg.block);
+                        }
+                    },
+                    [&](ObjectDef& arg) {
+                        for (auto& attribute : arg.attributes) {
+                            if (attribute.value) {
+                                optimizer.Optimize(*attribute.value);
+                            }
+                        }
+                    },
+                },
+                definition);
+        }
+    }
+
+    // Body of a function parsed after the rest of the tree
+    static void Optimize(const Global& root, FunctionDef& function) {
+        Optimizer(root).Optimize(*function.block);
+    }
+
+    // Drops functions and objects that no call or object initializer reachable from the entry
+    // functions refers to, entry functions that don't exist are ignored
+    static void Prune(Global& root, const std::vector<std::string>& entries) {
+        Optimizer optimizer(root);
+        for (const auto& entry : entries) {
+            if (root.Symbols().Contains(entry)) {
+                optimizer.Reach(root.Symbols()[entry].id);
+            }
+        }
+        while (!optimizer.pending.empty()) {
+            const FunctionDef* function = optimizer.pending.back();
+            optimizer.pending.pop_back();
+            if (std::holds_alternative<std::monostate>(function->externalFunction)) {
+                optimizer.Reach(*function->block);
+            }
+        }
+
+        root.definitions.remove_if([&](const auto& definition) {
+            return std::visit([&](const auto& arg) { return !optimizer.reachable.count(arg.name); }, definition);
+        });
+        root.library.functions.remove_if([&](const FunctionDef& function) { return !optimizer.reachable.count(function.name); });
+    }
+
+private:
+    void Optimize(Block& node) {
+        for (auto it = node.statements.begin(); it != node.statements.end();) {
+            if (!Optimize(*it)) {
+                it = node.statements.erase(it);
+            } else if (Returns(*it++)) {
+                node.statements.erase(it, node.statements.end());
+                break;
+            }
+        }
+    }
+
+    // Whether every path through the statement ends with a return
+    static bool Returns(const Block& node) {
+        return std::any_of(node.statements.begin(), node.statements.end(), [](const Statement& statement) { return Returns(statement); });
+    }
+
+    static bool Returns(const Statement& node) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) { return false; },
+                [&](const Return&) { return true; },
+                [&](const IfExpr& arg) {
+                    if (Literal(*arg.ifStatement->condition) == std::optional<Value>(true)) {
+                        return Returns(*arg.ifStatement->block);
+                    }
+                    return arg.elseStatement && Returns(*arg.ifStatement->block) && Returns(*arg.elseStatement->block)
+                        && std::all_of(arg.elseifStatements.begin(), arg.elseifStatements.end(), [](const Elseif& elseif) { return Returns(*elseif.block); });
+                },
+                [&](const WhileExpr& arg) { return arg.isDoWhile && Returns(*arg.block); },
+            },
+            node.expression);
+    }
+
+    // Returns false when the statement can be removed
+    bool Optimize(Statement& node) {
+        return std::visit(
+            Visitor{
+                [&](auto&) { return true; },
+                [&](Return& arg) {
+                    if (arg.value) {
+                        Optimize(*arg.value);
+                    }
+                    return true;
+                },
+                [&](ForExpr& arg) {
+                    Optimize(*arg.range->from);
+                    if (arg.range->to) {
+                        Optimize(*arg.range->to);
+                    }
+                    Optimize(*arg.block);
+                    return true;
+                },
+                [&](IfExpr& arg) { return Optimize(arg); },
+                [&](WhileExpr& arg) {
+                    Optimize(*arg.condition);
+                    Optimize(*arg.block);
+                    return arg.isDoWhile || Literal(*arg.condition) != std::optional<Value>(false);
+                },
+                [&](Expression& arg) {
+                    Optimize(arg);
+                    return true;
+                },
+            },
+            node.expression);
+    }
+
+    // Branches after one with a true condition are never taken and ones with a false condition are
+    // dropped, the compiler then skips the remaining constant conditions
+    bool Optimize(IfExpr& node) {
+        Optimize(*node.ifStatement->condition);
+        Optimize(*node.ifStatement->block);
+        auto taken = Literal(*node.ifStatement->condition) == std::optional<Value>(true);
+        for (auto it = node.elseifStatements.begin(); it != node.elseifStatements.end();) {
+            if (taken) {
+                it = node.elseifStatements.erase(it);
+                continue;
+            }
+            Optimize(*it->condition);
+            auto condition = Literal(*it->condition);
+            if (condition == std::optional<Value>(false)) {
+                it = node.elseifStatements.erase(it);
+                continue;
+            }
+            Optimize(*it->block);
+            taken = condition == std::optional<Value>(true);
+            ++it;
+        }
+        if (taken) {
+            node.elseStatement.reset();
+        } else if (node.elseStatement) {
+            Optimize(*node.elseStatement->block);
+        }
+        return node.elseStatement || !node.elseifStatements.empty() || Literal(*node.ifStatement->condition) != std::optional<Value>(false);
+    }
+
+    void Optimize(Expression& node) {
+        std::visit(
+            Visitor{
+                [&](auto&) {},
+                [&](UnaryOperation& arg) {
+                    Optimize(*arg.value);
+                    Fold(node, arg);
+                },
+                [&](BinaryOperation& arg) {
+                    Optimize(*arg.lhs);
+                    Optimize(*arg.rhs);
+                    if (!Fold(node, arg)) {
+                        Simplify(arg);
+                    }
+                },
+                [&](VariableRef& arg) {
+                    if (arg.chainedOperation) {
+                        Optimize(*arg.chainedOperation);
+                    }
+                },
+                [&](VariableDef& arg) {
+                    if (arg.value) {
+                        Optimize(*arg.value);
+                    }
+                },
+                [&](ObjectInitializer& arg) {
+                    for (auto& value : arg.values) {
+                        Optimize(value.second);
+                    }
+                },
+                [&](ArrayInitializer& arg) {
+                    for (auto& value : arg.values) {
+                        Optimize(value);
+                    }
+                },
+            },
+            node.expression);
+    }
+
+    void Optimize(ChainedOperation& node) {
+        std::visit(
+            Visitor{
+                [&](auto&) {},
+                [&](DotOperation& arg) {
+                    if (arg.chainedOperation) {
+                        Optimize(*arg.chainedOperation);
+                    }
+                },
+                [&](IndexOperation& arg) {
+                    Optimize(*arg.index);
+                    if (arg.chainedOperation) {
+                        Optimize(*arg.chainedOperation);
+                    }
+                },
+                [&](VariableAssign& arg) { Optimize(*arg.value); },
+                [&](FunctionCall& arg) {
+                    for (auto& argument : arg.arguments) {
+                        Optimize(argument);
+                    }
+                    if (arg.chainedOperation) {
+                        Optimize(*arg.chainedOperation);
+                    }
+                },
+            },
+            node.operation);
+    }
+
+    // Operations that would fail are left to report the error when they are executed
+    static bool Fold(Expression& node, const UnaryOperation& operation) {
+        auto value = Literal(*operation.value);
+        if (!value) {
+            return false;
+        }
+        try {
+            if (operation.operation == "!") {
+                return Replace(node, !*value);
+            }
+            if (operation.operation == "++") {
+                return Replace(node, ++*value);
+            }
+            if (operation.operation == "--") {
+                return Replace(node, --*value);
+            }
+        } catch (const InternalException&) {
+        }
+        return false;
+    }
+
+    static bool Fold(Expression& node, const BinaryOperation& operation) {
+        auto lhs = Literal(*operation.lhs);
+        auto rhs = Literal(*operation.rhs);
+        if (!lhs || !rhs) {
+            return false;
+        }
+        try {
+            const auto& op = operation.operation;
+            if (op == "+") {
+                return Replace(node, *lhs + *rhs);
+            }
+            if (op == "-") {
+                return Replace(node, *lhs - *rhs);
+            }
+            if (op == "*") {
+                return Replace(node, *lhs * *rhs);
+            }
+            if (op == "/") {
+                return Replace(node, *lhs / *rhs);
+            }
+            if (op == "&&") {
+                return Replace(node, *lhs && *rhs);
+            }
+            if (op == "||") {
+                return Replace(node, *lhs || *rhs);
+            }
+            if (op == "==") {
+                return Replace(node, *lhs == *rhs);
+            }
+            if (op == "!=") {
+                return Replace(node, *lhs != *rhs);
+            }
+            if (op == "<") {
+                return Replace(node, *lhs < *rhs);
+            }
+            if (op == "<=") {
+                return Replace(node, *lhs <= *rhs);
+            }
+            if (op == ">") {
+                return Replace(node, *lhs > *rhs);
+            }
+            if (op == ">=") {
+                return Replace(node, *lhs >= *rhs);
+            }
+        } catch (const InternalException&) {
+        }
+        return false;
+    }
+
+    // Identities that hold for every value of the type an operation is proven to give, e.g.
+    // *(-(a, b), 1). Typed variables can still hold values of other types, which the operation
+    // has to reject, so they are never dropped. Adding zero is not one of them as -0 + 0 is 0.
+    bool Simplify(BinaryOperation& operation) const {
+        const auto& op = operation.operation;
+        for (bool operandFirst : { true, false }) {
+            auto* operand = std::get_if<BinaryOperation>(&(operandFirst ? *operation.lhs : *operation.rhs).expression);
+            auto literal = Literal(operandFirst ? *operation.rhs : *operation.lhs);
+            if (!operand || !literal) {
+                continue;
+            }
+
+            if (Proven(*operand, "number") && std::holds_alternative<double>(*literal)) {
+                double value = std::get<double>(*literal);
+                bool zero = value == 0 && !std::signbit(value);
+                if ((op == "*" && value == 1) || (operandFirst && op == "/" && value == 1) || (operandFirst && op == "-" && zero)) {
+                    return Replace(operation, *operand);
+                }
+            } else if (Proven(*operand, "bool") && std::holds_alternative<bool>(*literal)) {
+                bool value = std::get<bool>(*literal);
+                if ((op == "&&" && value) || (op == "||" && !value)) {
+                    return Replace(operation, *operand);
+                }
+            } else if (Proven(*operand, "string")) {
+                if (op == "+" && *literal == Value(std::string())) {
+                    return Replace(operation, *operand);
+                }
+            }
+        }
+        return false;
+    }
+
+    // Operation whose result, when it doesn't throw, is always of the type
+    static bool Proven(const BinaryOperation& node, const std::string& type) {
+        static const std::set<std::string> numbers = { "-", "*", "/" };
+        static const std::set<std::string> bools = { "&&", "||", "==", "!=", "<", "<=", ">", ">=" };
+        if (type == "number") {
+            return numbers.count(node.operation) > 0;
+        }
+        if (type == "bool") {
+            return bools.count(node.operation) > 0;
+        }
+        // Strings are added only to strings
+        auto string = [](const Expression& operand) { return std::holds_alternative<std::string>(operand.expression); };
+        return type == "string" && node.operation == "+" && (string(*node.lhs) || string(*node.rhs));
+    }
+
+    void Reach(VarID name) {
+        if (!reachable.insert(name).second) {
+            return;
+        }
+        for (const auto& definition : root.definitions) {
+            std::visit(
+                Visitor{
+                    [&](const FunctionDef& arg) {
+                        if (arg.name == name) {
+                            pending.push_back(&arg);
+                        }
+                    },
+                    [&](const ObjectDef& arg) {
+                        if (arg.name != name) {
+                            return;
+                        }
+                        for (const auto& attribute : arg.attributes) {
+                            if (attribute.value) {
+                                Reach(*attribute.value);
+                            }
+                        }
+                    },
+                },
+                definition);
+        }
+    }
+
+    void Reach(const Block& node) {
+        for (const auto& statement : node.statements) {
+            std::visit(
+                Visitor{
+                    [&](const auto&) {},
+                    [&](const Return& arg) {
+                        if (arg.value) {
+                            Reach(*arg.value);
+                        }
+                    },
+                    [&](const ForExpr& arg) {
+                        Reach(*arg.range->from);
+                        if (arg.range->to) {
+                            Reach(*arg.range->to);
+                        }
+                        Reach(*arg.block);
+                    },
+                    [&](const IfExpr& arg) {
+                        Reach(*arg.ifStatement->condition);
+                        Reach(*arg.ifStatement->block);
+                        for (const auto& elseif : arg.elseifStatements) {
+                            Reach(*elseif.condition);
+                            Reach(*elseif.block);
+                        }
+                        if (arg.elseStatement) {
+                            Reach(*arg.elseStatement->block);
+                        }
+                    },
+                    [&](const WhileExpr& arg) {
+                        Reach(*arg.condition);
+                        Reach(*arg.block);
+                    },
+                    [&](const Expression& arg) { Reach(arg); },
+                },
+                statement.expression);
+        }
+    }
+
+    void Reach(const Expression& node) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const UnaryOperation& arg) { Reach(*arg.value); },
+                [&](const BinaryOperation& arg) {
+                    Reach(*arg.lhs);
+                    Reach(*arg.rhs);
+                },
+                [&](const VariableRef& arg) {
+                    if (arg.chainedOperation) {
+                        Reach(*arg.chainedOperation);
+                    }
+                },
+                [&](const VariableDef& arg) {
+                    if (arg.value) {
+                        Reach(*arg.value);
+                    }
+                },
+                [&](const ObjectInitializer& arg) {
+                    Reach(arg.type);
+                    for (const auto& value : arg.values) {
+                        Reach(value.second);
+                    }
+                },
+                [&](const ArrayInitializer& arg) {
+                    for (const auto& value : arg.values) {
+                        Reach(value);
+                    }
+                },
+            },
+            node.expression);
+    }
+
+    void Reach(const ChainedOperation& node) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const DotOperation& arg) {
+                    if (arg.chainedOperation) {
+                        Reach(*arg.chainedOperation);
+                    }
+                },
+                [&](const IndexOperation& arg) {
+                    Reach(*arg.index);
+                    if (arg.chainedOperation) {
+                        Reach(*arg.chainedOperation);
+                    }
+                },
+                [&](const VariableAssign& arg) { Reach(*arg.value); },
+                [&](const FunctionCall& arg) {
+                    if (const auto* name = std::get_if<VarID>(&arg.identifier)) {
+                        Reach(*name);
+                    } else if (root.Symbols().Contains(std::get<std::string>(arg.identifier))) {
+                        Reach(root.Symbols()[std::get<std::string>(arg.identifier)].id);
+                    }
+                    for (const auto& argument : arg.arguments) {
+                        Reach(argument);
+                    }
+                    if (arg.chainedOperation) {
+                        Reach(*arg.chainedOperation);
+                    }
+                },
+            },
+            node.operation);
+    }
+
+    static std::optional<Value> Literal(const Expression& node) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> std::optional<Value> { return std::nullopt; },
+                [&](bool arg) -> std::optional<Value> { return Value(arg); },
+                [&](double arg) -> std::optional<Value> { return Value(arg); },
+                [&](const std::string& arg) -> std::optional<Value> { return Value(arg); },
+            },
+            node.expression);
+    }
+
+    static bool Replace(Expression& node, const Value& value) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) { return false; },
+                [&](bool arg) {
+                    node.expression.emplace<std::decay_t<decltype(arg)>>(arg);
+                    return true;
+                },
+                [&](double arg) {
+                    node.expression.emplace<std::decay_t<decltype(arg)>>(arg);
+                    return true;
+                },
+                [&](const std::string& arg) {
+                    node.expression.emplace<std::decay_t<decltype(arg)>>(arg);
+                    return true;
+                },
+            },
+            value);
+    }
+
+    // The operation takes over the operator and operands of one of its operands
+    static bool Replace(BinaryOperation& node, BinaryOperation& operand) {
+        std::string operation = operand.operation;
+        VarID returnType = operand.returnType;
+        auto lhs = std::move(operand.lhs);
+        auto rhs = std::move(operand.rhs);
+        lhs->parent = &node;
+        rhs->parent = &node;
+        node.lhs = std::move(lhs);
+        node.rhs = std::move(rhs);
+        node.operation = operation;
+        node.returnType = returnType;
+        return true;
+    }
+};
+
+} // namespace Interpreter
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "Ast.hpp"
+
+namespace Interpreter {
+
+// Decides whether iterations of a parallel for loop can run concurrently. The body may call only
+// pure functions, may not return and may write variables of the function only as elements of an
+// array indexed by the control variable, e.g. squares[i] = *(i, i), so no iteration reads or
+// writes what another one writes. The control variable itself is never written.
+//
+// Variables of the function the body uses are either copied into every chunk of iterations or,
+// when they are only ever indexed, shared with the chunks through references so arrays are not
+// copied. Written arrays are always shared.
+class ParallelLoop {
+public:
+    struct Captures {
+        std::vector<VarID> copied;
+        std::vector<VarID> shared;
+    };
+
+private:
+    struct Use {
+        bool copied = false;
+        bool indexed = false;
+        bool written = false;
+        // Indexed by anything else than the control variable
+        bool elsewhere = false;
+    };
+
+    const std::set<VarID>& pure;
+    VarID control;
+    std::set<VarID> locals;
+    std::map<VarID, Use> uses;
+    std::vector<VarID> order;
+    bool safe = true;
+
+    ParallelLoop(const ForExpr& node, const std::set<VarID>& pure)
+        : pure(pure), control(node.controlVariable->name) {
+        locals.insert(control);
+    }
+
+public:
+    static bool Find(const ForExpr& node, const std::set<VarID>& pure, Captures& captures) {
+        ParallelLoop loop(node, pure);
+        loop.Visit(*node.block);
+        if (!loop.safe) {
+            return false;
+        }
+
+        for (VarID name : loop.order) {
+            const Use& use = loop.uses[name];
+            if (use.written && (use.copied || use.elsewhere)) {
+                return false;
+            }
+            (use.copied ? captures.copied : captures.shared).push_back(name);
+        }
+        return true;
+    }
+
+private:
+    Use& Used(VarID name) {
+        if (!uses.count(name)) {
+            order.push_back(name);
+        }
+        return uses[name];
+    }
+
+    bool Counter(const Expression& node) const {
+        const auto* ref = std::get_if<VariableRef>(&node.expression);
+        return ref && ref->name == control && !ref->chainedOperation;
+    }
+
+    void Visit(const Block& node) {
+        for (const auto& statement : node.statements) {
+            std::visit(
+                Visitor{
+                    [&](const auto&) {},
+                    [&](const Return&) { safe = false; },
+                    [&](const ForExpr& arg) {
+                        locals.insert(arg.controlVariable->name);
+                        Visit(*arg.range->from);
+                        if (arg.range->to) {
+                            Visit(*arg.range->to);
+                        }
+                        Visit(*arg.block);
+                    },
+                    [&](const IfExpr& arg) {
+                        Visit(*arg.ifStatement->condition);
+                        Visit(*arg.ifStatement->block);
+                        for (const auto& elseif : arg.elseifStatements) {
+                            Visit(*elseif.condition);
+                            Visit(*elseif.block);
+                        }
+                        if (arg.elseStatement) {
+                            Visit(*arg.elseStatement->block);
+                        }
+                    },
+                    [&](const WhileExpr& arg) {
+                        Visit(*arg.condition);
+                        Visit(*arg.block);
+                    },
+                    [&](const Expression& arg) { Visit(arg); },
+                },
+                statement.expression);
+        }
+    }
+
+    void Visit(const Expression& node) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const UnaryOperation& arg) {
+                    // Tasks belong to the call that spawns them and values are yielded in order
+                    safe &= arg.operation != "spawn" && arg.operation != "await" && arg.operation != "yield";
+                    safe &= !((arg.operation == "++" || arg.operation == "--") && Counter(*arg.value));
+                    Visit(*arg.value);
+                },
+                [&](const BinaryOperation& arg) {
+                    Visit(*arg.lhs);
+                    Visit(*arg.rhs);
+                },
+                [&](const VariableRef& arg) { Visit(arg); },
+                [&](const VariableDef& arg) {
+                    locals.insert(arg.name);
+                    if (arg.value) {
+                        Visit(*arg.value);
+                    }
+                },
+                [&](const ObjectInitializer& arg) {
+                    for (const auto& value : arg.values) {
+                        Visit(value.second);
+                    }
+                },
+                [&](const ArrayInitializer& arg) {
+                    for (const auto& value : arg.values) {
+                        Visit(value);
+                    }
+                },
+            },
+            node.expression);
+    }
+
+    void Visit(const VariableRef& node) {
+        // Chunks split the range of the control variable, iterations may not move it
+        if (node.name == control && node.chainedOperation && std::holds_alternative<VariableAssign>(node.chainedOperation->operation)) {
+            safe = false;
+        }
+        if (node.Symbols()[node.name].isFunction || locals.count(node.name)) {
+            if (node.chainedOperation) {
+                Visit(*node.chainedOperation);
+            }
+            return;
+        }
+
+        Use& use = Used(node.name);
+        const auto* index = node.chainedOperation ? std::get_if<IndexOperation>(&node.chainedOperation->operation) : nullptr;
+        if (index && (!index->chainedOperation || std::holds_alternative<VariableAssign>(index->chainedOperation->operation))) {
+            use.indexed = true;
+            use.elsewhere |= !Counter(*index->index);
+            Visit(*index->index);
+            if (index->chainedOperation) {
+                use.written = true;
+                Visit(*std::get<VariableAssign>(index->chainedOperation->operation).value);
+            }
+            return;
+        }
+
+        use.copied = true;
+        if (node.chainedOperation) {
+            safe &= !Assigns(*node.chainedOperation);
+            Visit(*node.chainedOperation);
+        }
+    }
+
+    void Visit(const ChainedOperation& node) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const DotOperation& arg) {
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation);
+                    }
+                },
+                [&](const IndexOperation& arg) {
+                    Visit(*arg.index);
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation);
+                    }
+                },
+                [&](const VariableAssign& arg) { Visit(*arg.value); },
+                [&](const FunctionCall& arg) {
+                    const auto* name = std::get_if<VarID>(&arg.identifier);
+                    safe &= name && pure.count(*name);
+                    for (const auto& argument : arg.arguments) {
+                        Visit(argument);
+                    }
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation);
+                    }
+                },
+            },
+            node.operation);
+    }
+
+    // Chain of dot and index operations that ends with an assignment
+    static bool Assigns(const ChainedOperation& node) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) { return false; },
+                [&](const DotOperation& arg) { return arg.chainedOperation && Assigns(*arg.chainedOperation); },
+                [&](const IndexOperation& arg) { return arg.chainedOperation && Assigns(*arg.chainedOperation); },
+                [&](const VariableAssign&) { return true; },
+            },
+            node.operation);
+    }
+};
+
+} // namespace Interpreter
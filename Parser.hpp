@@ -1,8 +1,14 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <mutex>
+
 #include "Lexer.hpp"
-#include "Evaluator.hpp"
 #include "Ast.hpp"
+#include "Optimizer.hpp"
+#include "Compiler.hpp"
+#include "VirtualMachine.hpp"
 
 namespace Interpreter {
 
@@ -11,15 +17,74 @@ class Parser {
     Lexer lexer;
     Token token;
     Ast ast;
+    Program program;
+    mutable Output output;
 
 public:
-    Parser(const std::string& path)
-        : source(path), lexer(source), token(lexer.Next()), ast(token, [this]() { token = lexer.Next(); }) {}
+    Parser(const std::string& path, const CompilerOptions& options = {}, const ExternalDefinitions& externals = {})
+        : source(path), lexer(source), token(lexer.Next()), ast(token, [this]() { token = lexer.Next(); }, externals, options.parallelParsing, options.lazyParsing), program(Compile(ast, options)) {}
 
     const Ast& Tree() const { return ast; }
+    const Program& Bytecode() const { return program; }
+
+    // Sink of Write and WriteLine for calls evaluated by this parser
+    Output& Sink() const { return output; }
 
     Value Evaluate(const std::string function, int argc, char* argv[]) const {
-        std::list<Value> parsedArguments; 
+        return Evaluate(function, ParseArguments(argc, argv));
+    }
+
+    Value Evaluate(const std::string function, const std::list<Value>& arguments = {}) const {
+        return VirtualMachine(program, Dispatch::Threaded, nullptr, &output).Call(function, arguments);
+    }
+
+    // Values of a generator function one at a time, the parser must outlive the generator
+    Generator Generate(const std::string& function, const std::list<Value>& arguments = {}) const {
+        return Generator(program, function, arguments, Dispatch::Threaded, &output);
+    }
+
+    // A lazily parsed tree must outlive the program, its bodies are parsed as the program runs
+    static Program Compile(Ast& ast, const CompilerOptions& options) {
+        if (options.folding) {
+            Optimizer::Optimize(ast.Root());
+        }
+        if (!options.entries.empty() && !options.lazyParsing) {
+            Optimizer::Prune(ast.Root(), options.entries);
+        }
+        Program program = Compiler::Compile(ast.Root(), options);
+        if (options.lazyParsing) {
+            program.load = Loader(ast, options);
+        }
+        return program;
+    }
+
+    // Parses, typechecks and compiles bodies on the first call of their function. Errors of a body
+    // are compiled into the function so they are raised by its calls.
+    static std::function<void(Program&, CompiledFunction&)> Loader(Ast& ast, const CompilerOptions& options) {
+        auto mutex = std::make_shared<std::mutex>();
+        return [&ast, options, mutex](Program& program, CompiledFunction& function) {
+            // Bodies loaded on several threads share the symbols of the tree
+            std::lock_guard<std::mutex> lock(*mutex);
+            FunctionDef& func = ast.Root().GetFunction(function.name);
+            std::string error;
+            try {
+                func.ParsePending();
+                // Inferred return types are left out, calls were typechecked before any body was loaded
+                if (func.ReturnType() != func.Symbols()["any"].id) {
+                    func.MatchReturnType();
+                }
+                if (options.folding) {
+                    Optimizer::Optimize(ast.Root(), func);
+                }
+            } catch (const std::exception& err) {
+                error = err.what();
+            }
+            Compiler::Load(program, ast.Root(), function, options, error);
+        };
+    }
+
+    static std::list<Value> ParseArguments(int argc, char* argv[]) {
+        std::list<Value> parsedArguments;
         for (auto i = 0; i < argc; ++i) {
             std::string argument(argv[i]);
             char* end;
@@ -33,11 +98,7 @@ public:
                 parsedArguments.emplace_back(argument);
             }
         }
-        return Evaluate(function, parsedArguments);
-    }
-
-    Value Evaluate(const std::string function, const std::list<Value>& arguments = {}) const {
-        return Evaluator::Evaluate(ast.Root(), function, arguments);
+        return parsedArguments;
     }
 };
 
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <map>
+#include <set>
+
+#include "Ast.hpp"
+
+namespace Interpreter {
+
+// Finds script functions whose result depends only on their arguments. Values are copied into
+// calls so a function can't change objects of its caller, its only effects are those of the
+// functions it calls. External functions other than those of the library read input or write
+// output, so a function is pure when no call it makes, directly or through defaults of objects it
+// creates, reaches one. Functions that spawn or await tasks are impure too.
+class Purity {
+    const Global& root;
+
+    // Functions and objects referred to by each definition
+    std::map<VarID, std::set<VarID>> references;
+    std::set<VarID> impure;
+    VarID current = 0;
+
+    Purity(const Global& root)
+        : root(root) {}
+
+public:
+    static std::set<VarID> Find(const Global& root) {
+        Purity purity(root);
+        auto& impure = purity.impure;
+        for (const auto& definition : root.definitions) {
+            std::visit(
+                Visitor{
+                    [&](const FunctionDef& arg) {
+                        purity.current = arg.name;
+                        if (std::holds_alternative<std::monostate>(arg.externalFunction)) {
+                            purity.Visit(*arg.block);
+                        } else {
+                            impure.insert(arg.name);
+                        }
+                    },
+                    [&](const ObjectDef& arg) {
+                        purity.current = arg.name;
+                        for (const auto& attribute : arg.attributes) {
+                            if (attribute.value) {
+                                purity.Visit(*attribute.value);
+                            }
+                        }
+                    },
+                },
+                definition);
+        }
+
+        // Impurity spreads to everything that refers to an impure definition
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto& [name, referenced] : purity.references) {
+                if (impure.count(name)) {
+                    continue;
+                }
+                for (VarID reference : referenced) {
+                    if (impure.count(reference)) {
+                        impure.insert(name);
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::set<VarID> pure;
+        for (const auto& definition : root.definitions) {
+            if (const auto* function = std::get_if<FunctionDef>(&definition); function && !impure.count(function->name)) {
+                pure.insert(function->name);
+            }
+        }
+        for (const auto& function : root.library.functions) {
+            pure.insert(function.name);
+        }
+        return pure;
+    }
+
+private:
+    void Visit(const Block& node) {
+        for (const auto& statement : node.statements) {
+            std::visit(
+                Visitor{
+                    [&](const auto&) {},
+                    [&](const Return& arg) {
+                        if (arg.value) {
+                            Visit(*arg.value);
+                        }
+                    },
+                    [&](const ForExpr& arg) {
+                        Visit(*arg.range->from);
+                        if (arg.range->to) {
+                            Visit(*arg.range->to);
+                        }
+                        Visit(*arg.block);
+                    },
+                    [&](const IfExpr& arg) {
+                        Visit(*arg.ifStatement->condition);
+                        Visit(*arg.ifStatement->block);
+                        for (const auto& elseif : arg.elseifStatements) {
+                            Visit(*elseif.condition);
+                            Visit(*elseif.block);
+                        }
+                        if (arg.elseStatement) {
+                            Visit(*arg.elseStatement->block);
+                        }
+                    },
+                    [&](const WhileExpr& arg) {
+                        Visit(*arg.condition);
+                        Visit(*arg.block);
+                    },
+                    [&](const Expression& arg) { Visit(arg); },
+                },
+                statement.expression);
+        }
+    }
+
+    void Visit(const Expression& node) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const UnaryOperation& arg) {
+                    if (arg.operation == "spawn" || arg.operation == "await") {
+                        impure.insert(current);
+                    }
+                    Visit(*arg.value);
+                },
+                [&](const BinaryOperation& arg) {
+                    Visit(*arg.lhs);
+                    Visit(*arg.rhs);
+                },
+                [&](const VariableRef& arg) {
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation);
+                    }
+                },
+                [&](const VariableDef& arg) {
+                    if (arg.value) {
+                        Visit(*arg.value);
+                    }
+                },
+                [&](const ObjectInitializer& arg) {
+                    references[current].insert(arg.type);
+                    for (const auto& value : arg.values) {
+                        Visit(value.second);
+                    }
+                },
+                [&](const ArrayInitializer& arg) {
+                    for (const auto& value : arg.values) {
+                        Visit(value);
+                    }
+                },
+            },
+            node.expression);
+    }
+
+    void Visit(const ChainedOperation& node) {
+        std::visit(
+            Visitor{
+                [&](const auto&) {},
+                [&](const DotOperation& arg) {
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation);
+                    }
+                },
+                [&](const IndexOperation& arg) {
+                    Visit(*arg.index);
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation);
+                    }
+                },
+                [&](const VariableAssign& arg) { Visit(*arg.value); },
+                [&](const FunctionCall& arg) {
+                    if (const auto* name = std::get_if<VarID>(&arg.identifier)) {
+                        references[current].insert(*name);
+                    } else if (root.Symbols().Contains(std::get<std::string>(arg.identifier))) {
+                        references[current].insert(root.Symbols()[std::get<std::string>(arg.identifier)].id);
+                    }
+                    for (const auto& argument : arg.arguments) {
+                        Visit(argument);
+                    }
+                    if (arg.chainedOperation) {
+                        Visit(*arg.chainedOperation);
+                    }
+                },
+            },
+            node.operation);
+    }
+};
+
+} // namespace Interpreter
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Library.hpp"
+#include "ValueOperators.hpp"
+#include "WrapperFunctions.hpp"
+
+// Support for C++ code generated from scripts by the Transpiler. Failures are reported with the
+// same messages the virtual machine uses.
+namespace Interpreter::Runtime {
+
+[[noreturn]] inline void Fail(const std::string& message, unsigned line) {
+    throw InterpreterException(message, line);
+}
+
+template <typename T>
+const char* TypeName();
+template <>
+inline const char* TypeName<double>() { return "number"; }
+template <>
+inline const char* TypeName<bool>() { return "bool"; }
+template <>
+inline const char* TypeName<std::string>() { return "string"; }
+
+// Converts value to a statically known type
+template <typename T>
+T As(const Value& value, unsigned line) {
+    const T* result = std::get_if<T>(&value);
+    if (!result) {
+        Fail("Value " + ToString(value) + " is not of type " + TypeName<T>() + ".", line);
+    }
+    return *result;
+}
+
+inline bool Condition(const Value& value, unsigned line) {
+    const bool* condition = std::get_if<bool>(&value);
+    if (!condition) {
+        Fail("Condition must be of type bool.", line);
+    }
+    return *condition;
+}
+
+inline double Bound(const Value& value, unsigned line) {
+    const double* bound = std::get_if<double>(&value);
+    if (!bound) {
+        Fail("Range bounds must be numbers.", line);
+    }
+    return *bound;
+}
+
+// Operands of logical operators are both evaluated
+inline bool And(bool lhs, bool rhs) { return lhs && rhs; }
+inline bool Or(bool lhs, bool rhs) { return lhs || rhs; }
+
+inline const Value& Field(const Value& value, const std::string& key, unsigned line) {
+    static const Value missing;
+    const Object* object = std::get_if<Object>(&value);
+    if (!object) {
+        Fail("Can't call an dot operator on non object type.", line);
+    }
+    auto it = object->values.find(key);
+    return it != object->values.end() ? it->second : missing;
+}
+
+inline Value& FieldRef(Value& value, const std::string& key, unsigned line) {
+    Object* object = std::get_if<Object>(&value);
+    if (!object) {
+        Fail("Can't call an dot operator on non object type.", line);
+    }
+    return object->values[key];
+}
+
+// Position of an element of an array, indices are numbers that are never converted to text
+inline size_t Element(const Array& array, const Value& index, unsigned line) {
+    size_t position = array.Position(index);
+    if (position == array.Size()) {
+        if (!IsNumber(index)) {
+            Fail("Can't index an array with non number type.", line);
+        }
+        Fail("Index " + ToString(index) + " is out of bounds of array of size " + std::to_string(array.Size()) + ".", line);
+    }
+    return position;
+}
+
+inline Value& IndexRef(Value& value, const Value& index, unsigned line) {
+    // Elements of packed arrays have no value to refer to, so the array is unpacked
+    if (Array* array = std::get_if<Array>(&value)) {
+        size_t position = Element(*array, index, line);
+        array->Unpack();
+        return array->values[position];
+    }
+    Object* object = std::get_if<Object>(&value);
+    if (!object) {
+        Fail("Can't call an index operator on non object or array type.", line);
+    }
+    const std::string* key = std::get_if<std::string>(&index);
+    if (!key) {
+        Fail("Can't call an index operator with non string type.", line);
+    }
+    auto it = object->values.find(*key);
+    if (it == object->values.end()) {
+        Fail("Object does not contain key " + *key + ".", line);
+    }
+    return it->second;
+}
+
+inline Value Index(const Value& value, const Value& index, unsigned line) {
+    if (const Array* array = std::get_if<Array>(&value)) {
+        return array->At(Element(*array, index, line));
+    }
+    return IndexRef(const_cast<Value&>(value), index, line);
+}
+
+inline Value NewObject(std::map<std::string, Value>&& values) {
+    return Object(std::move(values));
+}
+
+inline Value NewArray(std::vector<Value>&& values) {
+    return Array(std::move(values));
+}
+
+// Counter of a for loop over a range of numbers
+class Range {
+    double counter;
+    double limit;
+    double step;
+
+public:
+    Range(double from, double to, bool includeLast)
+        : counter(from), limit(to), step(from < to ? 1 : -1) {
+        if (includeLast) {
+            limit += step;
+        }
+    }
+
+    double Counter() const { return counter; }
+    void Step() { counter += step; }
+    explicit operator bool() const { return step > 0 ? counter < limit : counter > limit; }
+};
+
+} // namespace Interpreter::Runtime
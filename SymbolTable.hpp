@@ -27,9 +27,30 @@ struct Symbol {
 
 class SymbolTable {
     VarID nextID = 0;
+    bool numbered = false;
 
     std::map<std::string, Symbol> local;
     SymbolTable* parent;
+    // Searched for names and ids neither this table nor its parents contain, its parents are not
+    // searched
+    const SymbolTable* fallback = nullptr;
+    // Names found in the parents with ids in (hiddenFrom, hiddenTo] are treated as not yet defined
+    VarID hiddenFrom = 0;
+    VarID hiddenTo = 0;
+
+    const Symbol* Find(const std::string& key) const {
+        auto it = local.find(key);
+        if (it != local.end())
+            return &it->second;
+        const Symbol* symbol = parent != nullptr ? parent->Find(key) : nullptr;
+        if (symbol != nullptr && symbol->id > hiddenFrom && symbol->id <= hiddenTo)
+            return nullptr;
+        return symbol;
+    }
+
+    const SymbolTable* Root() const {
+        return parent != nullptr ? parent->Root() : this;
+    }
 
 public:
     SymbolTable(SymbolTable* parent)
@@ -43,22 +64,26 @@ public:
         return local[key].id = NextID();
     }
 
+    // Symbols of the fallback don't count, a definition can take their names
     bool Contains(const std::string& key) const {
-        return local.find(key) != local.end() || (parent != nullptr && parent->Contains(key));
+        return Find(key) != nullptr;
     }
 
     const Symbol& operator[](const VarRef& ref) const {
-        auto it = std::visit(
-            Visitor{
-                [&](VarID arg) { return std::find_if(local.begin(), local.end(), [arg](const auto& e) { return e.second.id == arg; }); },
-                [&](const std::string& arg) { return local.find(arg); },
-            },
-            ref
-        );
-        if (it != local.end())
-            return it->second;
-        if (parent != nullptr)
-            return (*parent)[ref];
+        if (const auto* key = std::get_if<std::string>(&ref)) {
+            if (const Symbol* symbol = Find(*key))
+                return *symbol;
+        } else {
+            VarID id = std::get<VarID>(ref);
+            auto it = std::find_if(local.begin(), local.end(), [id](const auto& e) { return e.second.id == id; });
+            if (it != local.end())
+                return it->second;
+            if (parent != nullptr)
+                return (*parent)[ref];
+        }
+        const SymbolTable* root = Root();
+        if (root->fallback != nullptr && root->fallback->Holds(ref))
+            return (*root->fallback)[ref];
 
         std::visit(
             Visitor{
@@ -84,12 +109,46 @@ public:
         throw UndefinedIdentifierException(id);
     }
 
+    bool Holds(const VarRef& ref) const {
+        return std::visit(
+            Visitor{
+                [&](VarID arg) { return std::any_of(local.begin(), local.end(), [arg](const auto& e) { return e.second.id == arg; }); },
+                [&](const std::string& arg) { return local.find(arg) != local.end(); },
+            },
+            ref
+        );
+    }
+
+    void Fallback(const SymbolTable& table) {
+        fallback = &table;
+    }
+
+    // Lookups by name skip symbols of the parents with ids in (from, to], a body parsed after the
+    // rest of the file then sees the same definitions as one parsed in place
+    void Hide(VarID from, VarID to) {
+        hiddenFrom = from;
+        hiddenTo = to;
+    }
+
     VarID NextID() {
-        if (parent != nullptr)
+        if (parent != nullptr && !numbered)
             return parent->NextID();
         return ++nextID;
     }
 
+    VarID LastID() const {
+        if (parent != nullptr && !numbered)
+            return parent->LastID();
+        return nextID;
+    }
+
+    // Symbols added to the table and its children get ids following last instead of ids from the
+    // counter of the parent, so tables filled on several threads don't share a counter
+    void Number(VarID last) {
+        nextID = last;
+        numbered = true;
+    }
+
     friend std::ostream& operator<<(std::ostream& os, const SymbolTable& symbols) {
         os << "[ ";
         for (const auto& pair : symbols.local)
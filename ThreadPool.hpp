@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Interpreter {
+
+// Workers take tasks from the back of their own queue and steal from the front of the queues of
+// others once theirs is empty. A thread waiting for tasks runs queued tasks in the meantime, so a
+// task can wait for tasks it submits without holding a worker idle.
+class ThreadPool {
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    // Guards sleeping of workers and waiting threads, both are woken when a task is submitted or
+    // finishes
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<size_t> queued{ 0 };
+    std::atomic<size_t> next{ 0 };
+    bool stopping = false;
+
+    // Queue of the worker running on the current thread
+    inline static thread_local ThreadPool* current = nullptr;
+    inline static thread_local size_t own = 0;
+
+public:
+    explicit ThreadPool(unsigned count) {
+        for (unsigned i = 0; i < std::max(count, 1u); ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < queues.size(); ++i) {
+            workers.emplace_back([this, i]() { Work(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool shared by all scripts with one worker per hardware thread
+    static ThreadPool& Instance() {
+        static ThreadPool pool(std::thread::hardware_concurrency());
+        return pool;
+    }
+
+    size_t Size() const {
+        return workers.size();
+    }
+
+    void Submit(std::function<void()> task) {
+        size_t index = current == this ? own : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        ++queued;
+        Notify();
+    }
+
+    // Runs queued tasks until done returns true
+    void Wait(const std::function<bool()>& done) {
+        while (!done()) {
+            if (RunOne()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return queued > 0 || done(); });
+        }
+    }
+
+    // Runs task for every index below count and returns once all of them finish, the first
+    // exception thrown by a task is rethrown then
+    void Run(size_t count, const std::function<void(size_t)>& task) {
+        std::atomic<size_t> remaining{ count };
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        for (size_t i = 0; i < count; ++i) {
+            Submit([&, i]() {
+                try {
+                    task(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                --remaining;
+            });
+        }
+        Wait([&]() { return remaining == 0; });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void Work(size_t index) {
+        current = this;
+        own = index;
+        for (;;) {
+            if (RunOne()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return queued > 0 || stopping; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+
+    // Runs a task of the own queue or one stolen from another queue
+    bool RunOne() {
+        std::function<void()> task;
+        size_t first = current == this ? own : 0;
+        for (size_t i = 0; i < queues.size() && !task; ++i) {
+            Queue& queue = *queues[(first + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (i == 0 && current == this) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        if (!task) {
+            return false;
+        }
+        --queued;
+        task();
+        Notify();
+        return true;
+    }
+
+    void Notify() {
+        { std::lock_guard<std::mutex> lock(mutex); }
+        changed.notify_all();
+    }
+};
+
+} // namespace Interpreter
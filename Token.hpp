@@ -38,6 +38,7 @@ struct Token {
         Dot,
         Object,
         New,
+        Parallel,
         EoF,
         Invalid
     };
@@ -130,6 +131,8 @@ struct Token {
             return "Object";
         case New:
             return "New";
+        case Parallel:
+            return "Parallel";
         case EoF:
             return "EoF";
         case Invalid:
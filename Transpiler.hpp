@@ -0,0 +1,677 @@
+#pragma once
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Ast.hpp"
+
+namespace Interpreter {
+
+// Translates typechecked script into C++ source that uses native types wherever the type of a value
+// is statically known and Value everywhere else. Generated source includes Runtime.hpp and exports
+// extern "C" void InterpreterFunctions(Interpreter::ExternalDefinitions&) that adds all its functions
+// with their signatures so they can be registered like the predefined external functions.
+class Transpiler {
+    enum class Kind {
+        Void,
+        Number,
+        Bool,
+        String,
+        Value,
+    };
+
+    struct Code {
+        std::string text;
+        Kind kind;
+    };
+
+    const Global& root;
+    std::ostringstream out;
+    size_t depth = 0;
+    std::vector<std::string> prelude;
+    unsigned temporaries = 0;
+    Kind returnKind = Kind::Void;
+
+    Transpiler(const Global& root)
+        : root(root) {}
+
+public:
+    static std::string Transpile(const Global& root, const std::string& source) {
+        Transpiler transpiler(root);
+        auto& out = transpiler.out;
+        out << "// Generated from " << source << " by InterpretCLI -cpp\n";
+        out << "#include \"Runtime.hpp\"\n\n";
+        out << "namespace Transpiled {\n";
+        out << "using namespace Interpreter;\n\n";
+
+        std::vector<const FunctionDef*> functions;
+        for (const auto& definition : root.definitions) {
+            const auto* function = std::get_if<FunctionDef>(&definition);
+            if (function && std::holds_alternative<std::monostate>(function->externalFunction)) {
+                functions.push_back(function);
+            }
+        }
+
+        for (const auto* function : functions) {
+            out << transpiler.Declaration(*function) << ";\n";
+        }
+        for (const auto* function : functions) {
+            out << "\n";
+            transpiler.Emit(*function);
+        }
+        for (const auto* function : functions) {
+            out << "\n";
+            transpiler.EmitEntry(*function);
+        }
+        out << "\n} // namespace Transpiled\n\n";
+
+        out << "extern \"C\" void InterpreterFunctions(Interpreter::ExternalDefinitions& definitions) {\n";
+        for (const auto* function : functions) {
+            out << "    definitions.push_back({ \"" << transpiler.Signature(*function) << "\", &Transpiled::" << transpiler.Function(*function) << "Entry });\n";
+        }
+        out << "}\n";
+        return out.str();
+    }
+
+private:
+    void Emit(const FunctionDef& node) {
+        returnKind = KindOf(root.Symbols()[node.name]);
+        temporaries = 0;
+        Line(Declaration(node) + " {");
+        ++depth;
+        Emit(*node.block);
+        // Reaching the end of a function that returns a native value is an error
+        const auto& statements = node.block->statements;
+        bool returns = !statements.empty() && std::holds_alternative<Return>(statements.back().expression);
+        if (!returns && returnKind == Kind::Value) {
+            Line("return Value();");
+        } else if (!returns && returnKind != Kind::Void) {
+            Line("Runtime::Fail(\"Function " + root.Symbols()[node.name].name + " did not return a value.\", " + std::to_string(node.line) + ");");
+        }
+        --depth;
+        Line("}");
+    }
+
+    // Adapts arguments passed by the interpreter to the native signature
+    void EmitEntry(const FunctionDef& node) {
+        const auto& arguments = node.arguments->arguments;
+        Line("Value " + Function(node) + "Entry(const Value*" + (arguments.empty() ? "" : " arguments") + ") {");
+        ++depth;
+        std::string call = Function(node) + "(";
+        size_t index = 0;
+        for (const auto& argument : arguments) {
+            std::string value = "arguments[" + std::to_string(index) + "]";
+            call += (index++ ? ", " : "") + Convert({ value, Kind::Value }, VariableKind(argument), node.line);
+        }
+        call += ")";
+        if (KindOf(root.Symbols()[node.name]) == Kind::Void) {
+            Line(call + ";");
+            Line("return Value();");
+        } else {
+            Line("return " + AsValue({ call, Kind::Value }) + ";");
+        }
+        --depth;
+        Line("}");
+    }
+
+    void Emit(const Block& node) {
+        for (const auto& statement : node.statements) {
+            Emit(statement);
+        }
+    }
+
+    void Emit(const Statement& node) {
+        std::visit(
+            Visitor{
+                [&](const auto&) { throw InterpreterException("Unknown operation.", node.line); },
+                [&](const Return& arg) { Emit(arg); },
+                [&](const ForExpr& arg) { Emit(arg); },
+                [&](const IfExpr& arg) { Emit(arg); },
+                [&](const WhileExpr& arg) { Emit(arg); },
+                [&](const Expression& arg) {
+                    if (const auto* definition = std::get_if<VariableDef>(&arg.expression)) {
+                        Declare(*definition);
+                        Flush();
+                        return;
+                    }
+                    auto code = Expr(arg);
+                    Flush();
+                    Line(code.text + ";");
+                },
+            },
+            node.expression);
+    }
+
+    void Emit(const Return& node) {
+        if (!node.value) {
+            Line(returnKind == Kind::Value ? "return Value();" : "return;");
+            return;
+        }
+
+        auto value = Expr(*node.value);
+        Flush();
+        if (returnKind == Kind::Void) {
+            Line(value.text + ";");
+            Line("return;");
+        } else {
+            Line("return " + Convert(value, returnKind, node.line) + ";");
+        }
+    }
+
+    void Emit(const IfExpr& node) {
+        auto condition = Condition(Expr(*node.ifStatement->condition), node.ifStatement->line);
+        Flush();
+        Line("if (" + condition + ") {");
+        Block(*node.ifStatement->block);
+
+        // Conditions that need statements of their own are nested into else blocks
+        size_t nested = 0;
+        for (const auto& elseif : node.elseifStatements) {
+            condition = Condition(Expr(*elseif.condition), elseif.line);
+            if (prelude.empty()) {
+                Line("} else if (" + condition + ") {");
+            } else {
+                Line("} else {");
+                ++depth;
+                ++nested;
+                Flush();
+                Line("if (" + condition + ") {");
+            }
+            Block(*elseif.block);
+        }
+        if (node.elseStatement) {
+            Line("} else {");
+            Block(*node.elseStatement->block);
+        }
+        Line("}");
+        for (; nested; --nested) {
+            --depth;
+            Line("}");
+        }
+    }
+
+    void Emit(const WhileExpr& node) {
+        if (node.isDoWhile) {
+            Line("do {");
+            ++depth;
+            Emit(*node.block);
+            auto condition = Condition(Expr(*node.condition), node.condition->line);
+            if (prelude.empty()) {
+                --depth;
+                Line("} while (" + condition + ");");
+                return;
+            }
+            Flush();
+            Line("if (!" + condition + ") {");
+            Line("    break;");
+            Line("}");
+            --depth;
+            Line("} while (true);");
+            return;
+        }
+
+        auto condition = Condition(Expr(*node.condition), node.condition->line);
+        if (prelude.empty()) {
+            Line("while (" + condition + ") {");
+            Block(*node.block);
+            Line("}");
+            return;
+        }
+        Line("for (;;) {");
+        ++depth;
+        Flush();
+        Line("if (!" + condition + ") {");
+        Line("    break;");
+        Line("}");
+        Emit(*node.block);
+        --depth;
+        Line("}");
+    }
+
+    void Emit(const ForExpr& node) {
+        if (!node.range->to) {
+            Line("Runtime::Fail(\"For loop range must have both bounds.\", " + std::to_string(node.line) + ");");
+            return;
+        }
+
+        auto from = Expr(*node.range->from);
+        if (!IsTrivial(*node.range->from) && !IsTrivial(*node.range->to)) {
+            from = Hoist(from);
+        }
+        auto to = Expr(*node.range->to);
+        auto range = "range" + std::to_string(++temporaries);
+        Flush();
+        Line("for (Runtime::Range " + range + "(" + Bound(from, node.line) + ", " + Bound(to, node.line) + ", " + (node.range->shouldIncludeLast ? "true" : "false") + "); " + range + "; " + range + ".Step()) {");
+        ++depth;
+        const auto& control = *node.controlVariable;
+        auto kind = VariableKind(control);
+        Line("[[maybe_unused]] " + Type(kind) + " " + Variable(control) + " = " + Convert({ range + ".Counter()", Kind::Number }, kind, node.line) + ";");
+        Emit(*node.block);
+        --depth;
+        Line("}");
+    }
+
+    void Block(const Interpreter::Block& node) {
+        ++depth;
+        Emit(node);
+        --depth;
+    }
+
+    Code Expr(const Expression& node) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> Code { throw InterpreterException("Unknown operation.", node.line); },
+                [&](const UnaryOperation& arg) { return Expr(arg); },
+                [&](const BinaryOperation& arg) { return Expr(arg); },
+                [&](const VariableRef& arg) { return Expr(arg); },
+                [&](const VariableDef& arg) { return Declare(arg); },
+                [&](const ObjectInitializer& arg) { return Expr(arg); },
+                [&](const ArrayInitializer& arg) { return Expr(arg); },
+                [&](bool arg) { return Code{ arg ? "true" : "false", Kind::Bool }; },
+                [&](double arg) { return Code{ Number(arg), Kind::Number }; },
+                [&](const std::string& arg) { return Code{ "std::string(" + Quote(arg) + ")", Kind::String }; },
+            },
+            node.expression);
+    }
+
+    Code Expr(const UnaryOperation& node) {
+        auto value = Expr(*node.value);
+        if (node.operation == "!") {
+            return value.kind == Kind::Bool ? Code{ "!" + value.text, Kind::Bool } : Code{ "operator!(" + AsValue(value) + ")", Kind::Value };
+        }
+        if (node.operation == "++" || node.operation == "--") {
+            if (value.kind == Kind::Number) {
+                return { "(" + value.text + (node.operation == "++" ? " + 1.0)" : " - 1.0)"), Kind::Number };
+            }
+            return { "operator" + node.operation + "(" + AsValue(value) + ")", Kind::Value };
+        }
+        // Transpiled code runs on a single thread, a spawned call is made right away and awaiting
+        // its handle gives its result
+        if (node.operation == "spawn" || node.operation == "await") {
+            return { AsValue(value), Kind::Value };
+        }
+        return Fail("Operator " + node.operation + " not implemented.", node.line);
+    }
+
+    Code Expr(const BinaryOperation& node) {
+        auto lhs = Expr(*node.lhs);
+        if (!IsTrivial(*node.lhs) && !IsTrivial(*node.rhs)) {
+            lhs = Hoist(lhs);
+        }
+        auto rhs = Expr(*node.rhs);
+        const auto& op = node.operation;
+        bool native = lhs.kind == rhs.kind && lhs.kind != Kind::Value && lhs.kind != Kind::Void;
+
+        if (op == "+" || op == "-" || op == "*" || op == "/") {
+            if (native && (lhs.kind == Kind::Number || (lhs.kind == Kind::String && op == "+"))) {
+                return { "(" + lhs.text + " " + op + " " + rhs.text + ")", lhs.kind };
+            }
+            return { "(" + AsValue(lhs) + " " + op + " " + AsValue(rhs) + ")", Kind::Value };
+        }
+        if (op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=") {
+            if (native) {
+                return { "(" + lhs.text + " " + op + " " + rhs.text + ")", Kind::Bool };
+            }
+            return { "(" + AsValue(lhs) + " " + op + " " + AsValue(rhs) + ")", Kind::Bool };
+        }
+        if (op == "&&" || op == "||") {
+            if (native && lhs.kind == Kind::Bool) {
+                return { std::string(op == "&&" ? "Runtime::And(" : "Runtime::Or(") + lhs.text + ", " + rhs.text + ")", Kind::Bool };
+            }
+            return { "(" + AsValue(lhs) + " " + op + " " + AsValue(rhs) + ")", Kind::Value };
+        }
+        return Fail("Operator " + op + " not implemented.", node.line);
+    }
+
+    Code Expr(const VariableRef& node) {
+        const Symbol& symbol = node.Symbols()[node.name];
+        if (symbol.isFunction) {
+            if (!node.chainedOperation) {
+                return Fail("Function " + symbol.name + " can't be used as a value.", node.line);
+            }
+            return Chain(*node.chainedOperation, { "", Kind::Void }, false);
+        }
+
+        Code variable{ symbol.name + "_" + std::to_string(symbol.id), KindOf(symbol) };
+        if (!node.chainedOperation) {
+            return variable;
+        }
+        if (const auto* assign = std::get_if<VariableAssign>(&node.chainedOperation->operation)) {
+            auto value = Expr(*assign->value);
+            return { "(" + variable.text + " = " + Convert(value, variable.kind, assign->line) + ")", variable.kind };
+        }
+
+        bool write = Assignment(*node.chainedOperation);
+        if (write && variable.kind != Kind::Value) {
+            return Fail("Can't call an dot operator on non object type.", node.line);
+        }
+        return Chain(*node.chainedOperation, variable, write);
+    }
+
+    // Walks dot and index operators, writes go through references to the stored values
+    Code Chain(const ChainedOperation& node, const Code& base, bool write) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> Code { throw InterpreterException("Unknown operation.", node.line); },
+                [&](const DotOperation& arg) {
+                    if (!std::holds_alternative<std::string>(arg.attribute) && arg.scope[arg.attribute].isFunction) {
+                        if (!arg.chainedOperation) {
+                            return Fail("Function " + arg.scope[arg.attribute].name + " can't be used as a value.", arg.line);
+                        }
+                        return Chain(*arg.chainedOperation, base, write);
+                    }
+                    auto key = Quote(Key(arg)) + ", " + std::to_string(arg.line);
+                    Code field = write ? Code{ "Runtime::FieldRef(" + base.text + ", " + key + ")", Kind::Value }
+                                       : Code{ "Runtime::Field(" + AsValue(base) + ", " + key + ")", Kind::Value };
+                    return arg.chainedOperation ? Chain(*arg.chainedOperation, field, write) : field;
+                },
+                [&](const IndexOperation& arg) {
+                    auto index = AsValue(Expr(*arg.index)) + ", " + std::to_string(arg.line);
+                    Code element = write ? Code{ "Runtime::IndexRef(" + base.text + ", " + index + ")", Kind::Value }
+                                         : Code{ "Runtime::Index(" + AsValue(base) + ", " + index + ")", Kind::Value };
+                    return arg.chainedOperation ? Chain(*arg.chainedOperation, element, write) : element;
+                },
+                [&](const VariableAssign& arg) {
+                    return Code{ "(" + base.text + " = " + AsValue(Expr(*arg.value)) + ")", Kind::Value };
+                },
+                [&](const FunctionCall& arg) { return Expr(arg); },
+            },
+            node.operation);
+    }
+
+    Code Expr(const FunctionCall& node) {
+        const FunctionDef* function = nullptr;
+        try {
+            function = &root.GetFunction(node.identifier);
+        } catch (const UndefinedIdentifierException& err) {
+            return Fail(err.what(), node.line);
+        }
+        const auto& parameters = function->arguments->arguments;
+        if (node.arguments.size() != parameters.size()) {
+            return Fail(TypeMismatchException(std::to_string(node.arguments.size()) + "arg(s)", std::to_string(parameters.size()) + "arg(s)", node.line, "function call with incorrect arguments").what(), node.line);
+        }
+
+        // Evaluation order of C++ arguments is unspecified so all but the last argument with side effects are hoisted
+        size_t complex = std::count_if(node.arguments.begin(), node.arguments.end(), [](const Expression& arg) { return !IsTrivial(arg); });
+        std::string arguments;
+        auto parameter = parameters.begin();
+        for (const auto& argument : node.arguments) {
+            auto code = Expr(argument);
+            if (!IsTrivial(argument) && --complex) {
+                code = Hoist(code);
+            }
+            arguments += (arguments.empty() ? "" : ", ") + Convert(code, VariableKind(*parameter++), node.line);
+        }
+
+        Code call{ Function(*function) + "(" + arguments + ")", KindOf(root.Symbols()[function->name]) };
+        if (!std::holds_alternative<std::monostate>(function->externalFunction)) {
+            call.text = External(*function, node.line) + "(" + arguments + ")";
+        }
+        if (!node.chainedOperation) {
+            return call;
+        }
+
+        bool write = Assignment(*node.chainedOperation);
+        if (write) {
+            auto temporary = "t" + std::to_string(++temporaries);
+            prelude.push_back("Value " + temporary + " = " + AsValue(call) + ";");
+            call = { temporary, Kind::Value };
+        }
+        return Chain(*node.chainedOperation, call, write);
+    }
+
+    Code Declare(const VariableDef& node) {
+        auto kind = VariableKind(node);
+        auto name = Variable(node);
+        if (node.value) {
+            auto value = Convert(Expr(*node.value), kind, node.line);
+            prelude.push_back(Type(kind) + " " + name + " = " + value + ";");
+        } else {
+            prelude.push_back(Type(kind) + " " + name + (kind == Kind::Value ? ";" : "{};"));
+        }
+        return { name, kind };
+    }
+
+    Code Expr(const ObjectInitializer& node) {
+        const ObjectDef& objectDef = root.GetObject(node.type);
+        std::string values;
+        for (const auto& attribute : objectDef.attributes) {
+            std::string value = "Value()";
+            auto expressionIt = node.values.find(attribute.name);
+            if (expressionIt != node.values.end()) {
+                value = AsValue(Expr(expressionIt->second));
+            } else if (attribute.value) {
+                value = AsValue(Expr(*attribute.value));
+            }
+            values += std::string(values.empty() ? "" : ", ") + "{ " + Quote(objectDef.Symbols()[attribute.name].name) + ", " + value + " }";
+        }
+        return { "Runtime::NewObject({ " + values + " })", Kind::Value };
+    }
+
+    Code Expr(const ArrayInitializer& node) {
+        std::string values;
+        for (const auto& value : node.values) {
+            values += (values.empty() ? "" : ", ") + AsValue(Expr(value));
+        }
+        return { "Runtime::NewArray({ " + values + " })", Kind::Value };
+    }
+
+    // Predefined functions are called directly, functions registered by the host have no C++ name
+    std::string External(const FunctionDef& node, unsigned line) const {
+        const auto& name = root.Symbols()[node.name].name;
+        if (name == "Write" || name == "WriteLine" || name == "ReadNumber" || name == "ReadText") {
+            return name;
+        }
+        if (node.parent == &root.library) {
+            return "Library::" + name;
+        }
+        throw InterpreterException("Can't transpile call of external function " + name + ".", line);
+    }
+
+    // Literals and plain variables can be evaluated in any order
+    static bool IsTrivial(const Expression& node) {
+        if (const auto* ref = std::get_if<VariableRef>(&node.expression)) {
+            return !ref->chainedOperation;
+        }
+        return std::holds_alternative<bool>(node.expression) || std::holds_alternative<double>(node.expression) || std::holds_alternative<std::string>(node.expression);
+    }
+
+    static bool Assignment(const ChainedOperation& node) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) { return false; },
+                [&](const DotOperation& arg) { return arg.chainedOperation && Assignment(*arg.chainedOperation); },
+                [&](const IndexOperation& arg) { return arg.chainedOperation && Assignment(*arg.chainedOperation); },
+                [&](const VariableAssign&) { return true; },
+            },
+            node.operation);
+    }
+
+    static std::string Key(const DotOperation& node) {
+        return std::visit(
+            Visitor{
+                [&](VarID) { return node.scope[node.attribute].name; },
+                [&](const std::string& arg) { return arg; },
+            },
+            node.attribute);
+    }
+
+    Code Hoist(const Code& code) {
+        if (code.kind == Kind::Void) {
+            return code;
+        }
+        auto temporary = "t" + std::to_string(++temporaries);
+        prelude.push_back("const " + Type(code.kind) + " " + temporary + " = " + code.text + ";");
+        return { temporary, code.kind };
+    }
+
+    Code Fail(const std::string& message, unsigned line) const {
+        return { "Runtime::Fail(" + Quote(message) + ", " + std::to_string(line) + ")", Kind::Void };
+    }
+
+    std::string Convert(const Code& code, Kind kind, unsigned line) const {
+        if (code.kind == kind || kind == Kind::Void) {
+            return code.text;
+        }
+        if (kind == Kind::Value) {
+            return AsValue(code);
+        }
+        return "Runtime::As<" + Type(kind) + ">(" + AsValue(code) + ", " + std::to_string(line) + ")";
+    }
+
+    std::string AsValue(const Code& code) const {
+        switch (code.kind) {
+        case Kind::Value:
+            return code.text;
+        case Kind::Void:
+            return "(" + code.text + ", Value())";
+        default:
+            return "Value(" + code.text + ")";
+        }
+    }
+
+    std::string Condition(const Code& code, unsigned line) const {
+        return code.kind == Kind::Bool ? "(" + code.text + ")" : "Runtime::Condition(" + AsValue(code) + ", " + std::to_string(line) + ")";
+    }
+
+    std::string Bound(const Code& code, unsigned line) const {
+        return code.kind == Kind::Number ? code.text : "Runtime::Bound(" + AsValue(code) + ", " + std::to_string(line) + ")";
+    }
+
+    Kind KindOf(const Symbol& symbol) const {
+        const auto& symbols = root.Symbols();
+        if (symbol.isArray) {
+            return Kind::Value;
+        }
+        if (symbol.type == symbols["void"].id) {
+            return Kind::Void;
+        }
+        if (symbol.type == symbols["number"].id) {
+            return Kind::Number;
+        }
+        if (symbol.type == symbols["bool"].id) {
+            return Kind::Bool;
+        }
+        if (symbol.type == symbols["string"].id) {
+            return Kind::String;
+        }
+        return Kind::Value;
+    }
+
+    Kind VariableKind(const VariableDef& node) const {
+        auto kind = KindOf(node.Symbols()[node.name]);
+        return node.isArray || kind == Kind::Void ? Kind::Value : kind;
+    }
+
+    static std::string Type(Kind kind) {
+        switch (kind) {
+        case Kind::Void:
+            return "void";
+        case Kind::Number:
+            return "double";
+        case Kind::Bool:
+            return "bool";
+        case Kind::String:
+            return "std::string";
+        default:
+            return "Value";
+        }
+    }
+
+    std::string Function(const FunctionDef& node) const {
+        return root.Symbols()[node.name].name + "_" + std::to_string(node.name);
+    }
+
+    static std::string Variable(const VariableDef& node) {
+        return node.Symbols()[node.name].name + "_" + std::to_string(node.name);
+    }
+
+    std::string Declaration(const FunctionDef& node) const {
+        std::string arguments;
+        for (const auto& argument : node.arguments->arguments) {
+            arguments += std::string(arguments.empty() ? "" : ", ") + "[[maybe_unused]] " + Type(VariableKind(argument)) + " " + Variable(argument);
+        }
+        return Type(KindOf(root.Symbols()[node.name])) + " " + Function(node) + "(" + arguments + ")";
+    }
+
+    // Signature the function is registered with, types without native representation are left out
+    std::string Signature(const FunctionDef& node) const {
+        auto annotation = [](Kind kind) -> std::string {
+            switch (kind) {
+            case Kind::Void:
+                return ": void";
+            case Kind::Number:
+                return ": number";
+            case Kind::Bool:
+                return ": bool";
+            case Kind::String:
+                return ": string";
+            default:
+                return "";
+            }
+        };
+
+        std::string arguments;
+        for (const auto& argument : node.arguments->arguments) {
+            arguments += (arguments.empty() ? "var " : ", var ") + node.Symbols()[argument.name].name + annotation(VariableKind(argument));
+        }
+        return "func " + root.Symbols()[node.name].name + "(" + arguments + ")" + annotation(KindOf(root.Symbols()[node.name]));
+    }
+
+    static std::string Number(double value) {
+        std::string text;
+        for (int precision = 1; precision <= 17; ++precision) {
+            std::ostringstream oss;
+            oss << std::setprecision(precision) << value;
+            text = oss.str();
+            if (std::stod(text) == value) {
+                break;
+            }
+        }
+        return text.find_first_of(".e") == std::string::npos ? text + ".0" : text;
+    }
+
+    static std::string Quote(const std::string& text) {
+        std::ostringstream oss;
+        oss << "\"";
+        for (char c : text) {
+            switch (c) {
+            case '"':
+                oss << "\\\"";
+                break;
+            case '\\':
+                oss << "\\\\";
+                break;
+            case '\n':
+                oss << "\\n";
+                break;
+            case '\t':
+                oss << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    oss << "\\" << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(c) << std::dec;
+                } else {
+                    oss << c;
+                }
+            }
+        }
+        oss << "\"";
+        return oss.str();
+    }
+
+    void Flush() {
+        for (const auto& line : prelude) {
+            Line(line);
+        }
+        prelude.clear();
+    }
+
+    void Line(const std::string& text) {
+        out << std::string(depth * 4, ' ') << text << "\n";
+    }
+};
+
+} // namespace Interpreter
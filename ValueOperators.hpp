@@ -4,77 +4,114 @@
 
 namespace Interpreter {
 
-#define arithmeticOperators(name) \
-inline Value operator##name(const Value& lhs, double rhs) {\
+// Results of integer operations that would differ from the same operation on doubles are promoted to double
+inline Value Add(Integer lhs, Integer rhs) { return IntegerResult(lhs + rhs); }
+inline Value Subtract(Integer lhs, Integer rhs) { return IntegerResult(lhs - rhs); }
+
+inline Value Multiply(Integer lhs, Integer rhs) {
+    double result = static_cast<double>(lhs) * static_cast<double>(rhs);
+    if (result > static_cast<double>(MaxInteger) || result < -static_cast<double>(MaxInteger) || (result == 0 && (lhs < 0 || rhs < 0))) {
+        return result;
+    }
+    return lhs * rhs;
+}
+
+inline Value Divide(Integer lhs, Integer rhs) {
+    if (rhs == 0 || lhs % rhs != 0 || (lhs == 0 && rhs < 0)) {
+        return static_cast<double>(lhs) / static_cast<double>(rhs);
+    }
+    return lhs / rhs;
+}
+
+// Strings support only concatenation, other operators would resolve to themselves through conversion to Value
+inline Value Concatenate(const std::string& lhs, const std::string& rhs) { return lhs + rhs; }
+inline Value InvalidStringOperation(const std::string&, const std::string&) { throw InternalException("Invalid operator use."); }
+
+#define arithmeticOperators(name, integerOperation, stringOperation) \
+inline Value operator name(const Value& lhs, double rhs) {\
     return std::visit(\
         Visitor{\
             [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
-            [&](double arg) { return Value(arg ##name rhs); },\
+            [&](double arg) { return Value(arg name rhs); },\
+            [&](Integer arg) { return Value(static_cast<double>(arg) name rhs); },\
         },\
         lhs);\
 }\
 \
-inline Value operator##name(const Value& lhs, const std::string& rhs) {\
+inline Value operator name(const Value& lhs, Integer rhs) {\
     return std::visit(\
         Visitor{\
             [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
-            [&](const std::string& arg) { return Value(arg ##name rhs); },\
+            [&](double arg) { return Value(arg name static_cast<double>(rhs)); },\
+            [&](Integer arg) { return integerOperation(arg, rhs); },\
         },\
         lhs);\
 }\
 \
-inline Value operator##name(const Value& lhs, const Value& rhs) {\
+inline Value operator name(const Value& lhs, const std::string& rhs) {\
     return std::visit(\
         Visitor{\
             [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
-            [&](double arg) { return lhs ##name arg; },\
-            [&](const std::string& arg) { return lhs ##name arg; },\
+            [&](const std::string& arg) { return stringOperation(arg, rhs); },\
+        },\
+        lhs);\
+}\
+\
+inline Value operator name(const Value& lhs, const Value& rhs) {\
+    return std::visit(\
+        Visitor{\
+            [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
+            [&](double arg) { return lhs name arg; },\
+            [&](Integer arg) { return lhs name arg; },\
+            [&](const std::string& arg) { return lhs name arg; },\
         },\
         rhs);\
 }
 
 #define logicalOperators(name) \
-inline Value operator##name(const Value& lhs, bool rhs) {\
+inline Value operator name(const Value& lhs, bool rhs) {\
     return std::visit(\
         Visitor{\
             [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
-            [&](bool arg) { return Value(arg ##name rhs); },\
+            [&](bool arg) { return Value(arg name rhs); },\
         },\
         lhs);\
 }\
 \
-inline Value operator##name(const Value& lhs, double rhs) {\
+inline Value operator name(const Value& lhs, double rhs) {\
     return std::visit(\
         Visitor{\
             [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
-            [&](double arg) { return Value(arg ##name rhs); },\
+            [&](double arg) { return Value(arg name rhs); },\
+            [&](Integer arg) { return Value(static_cast<double>(arg) name rhs); },\
         },\
         lhs);\
 }\
 \
-inline Value operator##name(const Value& lhs, const std::string& rhs) {\
+inline Value operator name(const Value& lhs, const std::string& rhs) {\
     return std::visit(\
         Visitor{\
             [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
-            [&](const std::string& arg) { return Value(arg ##name rhs); },\
+            [&](const std::string& arg) { return InvalidStringOperation(arg, rhs); },\
         },\
         lhs);\
 }\
 \
-inline Value operator##name(const Value& lhs, const Value& rhs) {\
+inline Value operator name(const Value& lhs, const Value& rhs) {\
     return std::visit(\
         Visitor{\
             [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },\
-            [&](bool arg) { return lhs ##name arg; },\
-            [&](double arg) { return lhs ##name arg; },\
-            [&](const std::string& arg) { return lhs ##name arg; },\
+            [&](bool arg) { return lhs name arg; },\
+            [&](double arg) { return lhs name arg; },\
+            [&](Integer arg) { return lhs name static_cast<double>(arg); },\
+            [&](const std::string& arg) { return lhs name arg; },\
         },\
         rhs);\
 }
-arithmeticOperators(+);
-arithmeticOperators(-);
-arithmeticOperators(*);
-arithmeticOperators(/);
+arithmeticOperators(+, Add, Concatenate);
+arithmeticOperators(-, Subtract, InvalidStringOperation);
+arithmeticOperators(*, Multiply, InvalidStringOperation);
+arithmeticOperators(/, Divide, InvalidStringOperation);
 logicalOperators(&&);
 logicalOperators(||);
 
@@ -92,6 +129,7 @@ return std::visit(
     Visitor{
         [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },
         [&](double arg) { return Value(++arg); },
+        [&](Integer arg) { return IntegerResult(arg + 1); },
     },
     value);
 }
@@ -101,8 +139,24 @@ return std::visit(
     Visitor{
         [&](const auto&) -> Value { throw InternalException("Invalid operator use."); },
         [&](double arg) { return Value(--arg); },
+        [&](Integer arg) { return IntegerResult(arg - 1); },
     },
     value);
 }
 
+// Integers and doubles are compared by their numeric value, other values as variants
+#define comparisonOperators(name) \
+inline bool operator name(const Value& lhs, const Value& rhs) {\
+    if (lhs.index() != rhs.index() && IsNumber(lhs) && IsNumber(rhs)) {\
+        return ToNumber(lhs) name ToNumber(rhs);\
+    }\
+    return std::operator name(lhs, rhs);\
+}
+comparisonOperators(==);
+comparisonOperators(!=);
+comparisonOperators(<);
+comparisonOperators(<=);
+comparisonOperators(>);
+comparisonOperators(>=);
+
 } // namespace Interpreter
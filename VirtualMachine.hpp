@@ -0,0 +1,1240 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Bytecode.hpp"
+#include "Jit.hpp"
+#include "ThreadPool.hpp"
+#include "ValueOperators.hpp"
+#include "WrapperFunctions.hpp"
+
+// Labels as values are a GCC and Clang extension, other compilers always use the switch dispatch
+#if defined(__GNUC__) && !defined(INTERPRETER_NO_COMPUTED_GOTO)
+#define INTERPRETER_COMPUTED_GOTO 1
+#else
+#define INTERPRETER_COMPUTED_GOTO 0
+#endif
+
+namespace Interpreter {
+
+enum class Dispatch {
+    Switch,
+    Threaded,
+};
+
+class VirtualMachine {
+    const Program& program;
+    Dispatch dispatch;
+    Profile* profile;
+
+    // Sink of Write and WriteLine, a machine given none writes to the standard output through a
+    // buffer of its own
+    std::shared_ptr<Output> own;
+    Output* output;
+
+public:
+    // When profile is given every executed instruction is recorded into it
+    VirtualMachine(const Program& program, Dispatch dispatch = Dispatch::Threaded, Profile* profile = nullptr, Output* output = nullptr)
+        : program(program), dispatch(INTERPRETER_COMPUTED_GOTO ? dispatch : Dispatch::Switch), profile(profile),
+          own(output ? nullptr : std::make_shared<Output>()), output(output ? output : own.get()) {}
+
+    Value Call(const std::string& name, const std::list<Value>& arguments) {
+        const CompiledFunction& function = program.GetFunction(name);
+        std::vector<Value> values = Arguments(function, arguments);
+        Output::Scope scope(*output);
+        Flush flush{ *output };
+        Join join{ *this };
+        Value result = Invoke(function, values.data());
+        Finish(true);
+        Normalize(result);
+        return result;
+    }
+
+private:
+    friend class Generator;
+
+    // Output written by the script is passed on once a call from the host returns, also by an
+    // exception
+    struct Flush {
+        Output& output;
+        ~Flush() { output.Flush(); }
+    };
+
+    // Tasks spawned during a call from the host finish before it returns, also by an exception
+    struct Join {
+        VirtualMachine& vm;
+        ~Join() { vm.Finish(false); }
+    };
+
+    static std::vector<Value> Arguments(const CompiledFunction& function, const std::list<Value>& arguments) {
+        if (arguments.size() != function.arguments) {
+            throw InterpreterException("Wrong number of arguments.", function.line);
+        }
+        std::vector<Value> values(arguments.begin(), arguments.end());
+        for (auto& value : values) {
+            if (const double* number = std::get_if<double>(&value)) {
+                value = Integral(*number);
+            }
+        }
+        return values;
+    }
+
+    // Call started by spawn, its handle is its index among the tasks of the top level call
+    struct Task {
+        std::atomic<bool> done{ false };
+        std::atomic<bool> awaited{ false };
+        Value result;
+        std::exception_ptr error;
+    };
+
+    // Shared by the machines running the tasks so a handle can be awaited by any of them
+    struct Tasks {
+        std::mutex mutex;
+        std::deque<Task> started;
+        std::atomic<size_t> running{ 0 };
+    };
+
+    // State of a run of native code passed to calls made from it
+    struct NativeFrame {
+        VirtualMachine& vm;
+        const CompiledFunction& function;
+        const NativeFunction& native;
+        double* slots;
+        Value pending;
+        std::exception_ptr error;
+    };
+
+    // Function a call returns to and the state it is resumed with, memoized is the callee whose
+    // result is cached under key once it returns
+    struct Frame {
+        const CompiledFunction* function;
+        const Instruction* ip;
+        Value* registers;
+        Value** references;
+        const CompiledFunction* memoized;
+        std::string key;
+    };
+
+    // Registers of a call made by the interpreter, kept once the call returns so later calls at
+    // the same depth reuse them
+    struct Storage {
+        std::vector<Value> registers;
+        std::vector<Value*> references;
+    };
+
+    // Sets a counter back to its value on entry when the scope is left, also by an exception
+    struct Restore {
+        unsigned& counter;
+        unsigned value;
+
+        Restore(unsigned& counter) : counter(counter), value(counter) {}
+        ~Restore() { counter = value; }
+    };
+
+    // Runs of native code and collected generators nest on the native stack, deeper calls
+    // continue in the interpreter and deeper generators fail
+    static constexpr unsigned NativeDepth = 256;
+
+    std::shared_ptr<Tasks> tasks;
+
+    // Script calls currently entered and how many of them run native code
+    unsigned depth = 0;
+    unsigned nativeDepth = 0;
+
+    // Registers of native code, for most functions they fit on the stack
+    struct NativeSlots {
+        double stack[16] = {};
+        std::vector<double> heap;
+        double* data = stack;
+
+        NativeSlots(unsigned count) {
+            if (count > std::size(stack)) {
+                heap.resize(count);
+                data = heap.data();
+            }
+        }
+    };
+
+    Value Invoke(const CompiledFunction& function, const Value* arguments) {
+        program.Load(function);
+        if (function.IsExternal()) {
+            return CallExternal(function, arguments);
+        }
+        if (function.generator) {
+            return Collect(function, arguments);
+        }
+        std::string key;
+        Value result;
+        if (Recall(function, arguments, key, result)) {
+            return result;
+        }
+        result = Invoke(function, Native(function), arguments);
+        if (!key.empty()) {
+            function.memo->Insert(std::move(key), result);
+        }
+        return result;
+    }
+
+    // Looks the call up in the cache of a memoized function, key is left empty when the result
+    // of the call can't be cached
+    static bool Recall(const CompiledFunction& function, const Value* arguments, std::string& key, Value& result) {
+        key.clear();
+        if (!function.memo) {
+            return false;
+        }
+        Memo::Key(arguments, function.arguments, key);
+        return !key.empty() && function.memo->Find(key, result);
+    }
+
+    Value Invoke(const CompiledFunction& function, const NativeFunction* native, const Value* arguments) {
+        // Native code is entered only when all arguments are numbers
+        if (native && Numbers(arguments, function.arguments)) {
+            NativeSlots slots(function.registers);
+            for (unsigned i = 0; i < function.arguments; ++i) {
+                slots.data[i] = ToNumber(arguments[i]);
+            }
+            return RunNative(function, *native, slots.data);
+        }
+
+        std::vector<Value> registers(function.registers);
+        std::copy(arguments, arguments + function.arguments, registers.begin());
+        return Interpret(function, registers.data(), 0);
+    }
+
+    // Counts the call and returns machine code of the function once it is hot enough
+    const NativeFunction* Native(const CompiledFunction& function) {
+        if (!INTERPRETER_JIT || profile || !program.jitThreshold || nativeDepth >= NativeDepth) {
+            return nullptr;
+        }
+        if (function.calls.load(std::memory_order_relaxed) < program.jitThreshold && function.calls.fetch_add(1, std::memory_order_relaxed) + 1 < program.jitThreshold) {
+            return nullptr;
+        }
+        std::call_once(function.compiled, [&]() { function.native = NativeFunction::Compile(function, program, &NativeCall); });
+        return function.native.get();
+    }
+
+    Value RunNative(const CompiledFunction& function, const NativeFunction& native, double* slots) {
+        Restore calls(depth);
+        Restore nested(nativeDepth);
+        Enter(function.line);
+        ++nativeDepth;
+        NativeFrame frame{ *this, function, native, slots, Value(), nullptr };
+        unsigned status = native.Run(slots, &frame);
+        if (frame.error) {
+            std::rethrow_exception(frame.error);
+        }
+
+        if (status & NativeFunction::Finished) {
+            unsigned ip = status & ~NativeFunction::Finished;
+            const Instruction& instruction = function.code[ip];
+            if (instruction.op == OpCode::ReturnVoid) {
+                return Value();
+            }
+            return NativeFunction::ToValue(slots[instruction.a], native.State(ip)[instruction.a]);
+        }
+
+        // Bail out to the interpreter after a call that did not return a number
+        const auto& state = native.State(status - 1);
+        std::vector<Value> registers(function.registers);
+        for (unsigned i = 0; i < function.registers; ++i) {
+            registers[i] = NativeFunction::ToValue(slots[i], state[i]);
+        }
+        registers[function.code[status - 1].a] = std::move(frame.pending);
+        return Interpret(function, registers.data(), status);
+    }
+
+    static int NativeCall(void* context, unsigned ip) {
+        auto& frame = *static_cast<NativeFrame*>(context);
+        const Instruction& instruction = frame.function.code[ip];
+        const CompiledFunction& callee = frame.vm.program.Load(frame.vm.program.functions[instruction.b]);
+        const auto& state = frame.native.State(ip);
+
+        // Exceptions can't be propagated through native code so they are rethrown once it returns
+        try {
+            Value result;
+            // Calls of memoized functions go through their cache
+            const NativeFunction* native = callee.IsExternal() || callee.memo ? nullptr : frame.vm.Native(callee);
+            if (native && std::all_of(state.begin() + instruction.c, state.begin() + instruction.c + callee.arguments, [](NativeType type) { return type == NativeType::Number; })) {
+                // Numbers are passed between native functions without conversion
+                NativeSlots slots(callee.registers);
+                std::copy(frame.slots + instruction.c, frame.slots + instruction.c + callee.arguments, slots.data);
+                result = frame.vm.RunNative(callee, *native, slots.data);
+            } else {
+                std::vector<Value> arguments(callee.arguments);
+                for (unsigned i = 0; i < callee.arguments; ++i) {
+                    arguments[i] = NativeFunction::ToValue(frame.slots[instruction.c + i], state[instruction.c + i]);
+                }
+                result = callee.IsExternal() || callee.memo ? frame.vm.Invoke(callee, arguments.data()) : frame.vm.Invoke(callee, native, arguments.data());
+            }
+
+            if (IsNumber(result)) {
+                frame.slots[instruction.a] = ToNumber(result);
+                return 0;
+            }
+            frame.pending = std::move(result);
+        } catch (const InternalException& err) {
+            frame.error = std::make_exception_ptr(InterpreterException(err.what(), instruction.line));
+        } catch (...) {
+            frame.error = std::current_exception();
+        }
+        return 1;
+    }
+
+    // A generator suspended by a yield sets resume to the instruction it continues from, resume
+    // stays untouched once it returns
+    Value Interpret(const CompiledFunction& function, Value* registers, unsigned start, Value* const* shared = nullptr, unsigned* resume = nullptr) {
+        std::vector<Value*> references(function.references);
+        if (shared) {
+            std::copy(shared, shared + function.shared, references.begin());
+        }
+        if (profile) {
+            if (dispatch == Dispatch::Threaded) {
+                return Execute<true, true>(function, registers, references.data(), start, resume);
+            }
+            return Execute<false, true>(function, registers, references.data(), start, resume);
+        }
+        if (dispatch == Dispatch::Threaded) {
+            return Execute<true, false>(function, registers, references.data(), start, resume);
+        }
+        return Execute<false, false>(function, registers, references.data(), start, resume);
+    }
+
+    // Script calls of a generator run it to its end and get the values it yields in an array
+    Value Collect(const CompiledFunction& generator, const Value* arguments) {
+        program.Load(generator);
+        if (nativeDepth >= NativeDepth) {
+            throw InterpreterException("Maximum generator nesting of " + std::to_string(NativeDepth) + " exceeded.", generator.line);
+        }
+        Restore nested(nativeDepth);
+        ++nativeDepth;
+        std::vector<Value> registers(generator.registers);
+        std::copy(arguments, arguments + generator.arguments, registers.begin());
+        Array values(std::vector<Value>{});
+        for (unsigned start = 0, resume = 0;; start = resume, resume = 0) {
+            Value value = Interpret(generator, registers.data(), start, nullptr, &resume);
+            if (!resume) {
+                return values;
+            }
+            values.Push(std::move(value));
+        }
+    }
+
+    void Enter(unsigned line) {
+        if (++depth > program.maxDepth) {
+            throw InterpreterException("Maximum call depth of " + std::to_string(program.maxDepth) + " exceeded.", line);
+        }
+    }
+
+    Value CallExternal(const CompiledFunction& function, const Value* arguments) {
+        return std::visit(
+            Visitor{
+                [&](const auto&) -> Value { throw InterpreterException("Unknown operation.", function.line); },
+                [&](fVoidValuePtr arg) {
+                    // Only values that are or may hold integers are copied to be normalized
+                    if (std::holds_alternative<Integer>(arguments[0]) || std::holds_alternative<Array>(arguments[0]) || std::holds_alternative<Object>(arguments[0])) {
+                        Value value = arguments[0];
+                        Normalize(value);
+                        arg(value);
+                    } else {
+                        arg(arguments[0]);
+                    }
+                    return Value();
+                },
+                [&](fStringPtr arg) { return Value(arg()); },
+                [&](fDoublePtr arg) { return Value(arg()); },
+                [&](fValuesPtr arg) {
+                    std::vector<Value> values(arguments, arguments + function.arguments);
+                    for (auto& value : values) {
+                        Normalize(value);
+                    }
+                    return arg(values.data());
+                },
+                [&](const fBound& arg) { return arg(arguments); },
+            },
+            function.externalFunction);
+    }
+
+// Every instruction body is reachable both as a switch case and, with threaded dispatch, as a label
+// whose address is stored directly in the instruction so the next handler is jumped to without a lookup
+#if INTERPRETER_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define VM_CASE(name) case OpCode::name: Label##name:
+#define VM_DISPATCH() if constexpr (Profiled) { profile->Record(ip->op); } if constexpr (Threaded) { goto *ip->handler; } else { continue; }
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_DISPATCH() if constexpr (Profiled) { profile->Record(ip->op); } continue
+#endif
+#define VM_NEXT() { ++ip; VM_DISPATCH(); }
+#define VM_JUMP(target) { ip = code + (target); VM_DISPATCH(); }
+
+    // Calls between interpreted functions don't recurse on the native stack, the caller is pushed to
+    // frames and the callee continues in the same loop until it returns to it
+    template <bool Threaded, bool Profiled>
+    Value Execute(const CompiledFunction& entry, Value* registers, Value** references, unsigned start, unsigned* resume) {
+#if INTERPRETER_COMPUTED_GOTO
+        [[maybe_unused]] static const void* const labels[] = {
+#define INTERPRETER_OPCODE_LABEL(name) &&Label##name,
+            INTERPRETER_OPCODES(INTERPRETER_OPCODE_LABEL)
+#undef INTERPRETER_OPCODE_LABEL
+        };
+#endif
+        auto prepare = [&]([[maybe_unused]] const CompiledFunction& function) {
+#if INTERPRETER_COMPUTED_GOTO
+            if constexpr (Threaded) {
+                std::call_once(function.threaded, [&]() {
+                    for (const auto& instruction : function.code) {
+                        instruction.handler = labels[static_cast<size_t>(instruction.op)];
+                    }
+                });
+            }
+#endif
+        };
+        prepare(entry);
+
+        Restore calls(depth);
+        Enter(entry.line);
+        std::vector<Frame> frames;
+        std::vector<Storage> storage;
+        std::vector<Value> arguments;
+        std::string key;
+        Value result;
+
+        const CompiledFunction* function = &entry;
+        const Instruction* code = entry.code.data();
+        const Value* constants = entry.constants.data();
+        const Instruction* ip = code + start;
+
+        // Switches to the callee in the registers reserved for calls at the given depth, arguments
+        // are moved in from the given range
+        auto enter = [&](const CompiledFunction& callee, size_t level, Value* first) {
+            if (storage.size() <= level) {
+                storage.resize(level + 1);
+            }
+            Storage& frame = storage[level];
+            frame.registers.assign(callee.registers, Value());
+            frame.references.assign(callee.references, nullptr);
+            std::move(first, first + callee.arguments, frame.registers.begin());
+            prepare(callee);
+            function = &callee;
+            code = callee.code.data();
+            constants = callee.constants.data();
+            registers = frame.registers.data();
+            references = frame.references.data();
+            ip = code;
+        };
+
+        if constexpr (Profiled) {
+            profile->Record(ip->op);
+        }
+        try {
+            for (;;) switch (ip->op) {
+            VM_CASE(LoadConstant) {
+                registers[ip->a] = constants[ip->b];
+                VM_NEXT();
+            }
+            VM_CASE(Move) {
+                registers[ip->a] = registers[ip->b];
+                VM_NEXT();
+            }
+            VM_CASE(Add) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return IntegerResult(lhs + rhs); })
+                    && !(ip->a == ip->b && Append(registers[ip->a], registers[ip->c]))) {
+                    registers[ip->a] = registers[ip->b] + registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(Subtract) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return IntegerResult(lhs - rhs); })) {
+                    registers[ip->a] = registers[ip->b] - registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(Multiply) {
+                registers[ip->a] = registers[ip->b] * registers[ip->c];
+                VM_NEXT();
+            }
+            VM_CASE(Divide) {
+                registers[ip->a] = registers[ip->b] / registers[ip->c];
+                VM_NEXT();
+            }
+            VM_CASE(Equal) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs == rhs; })) {
+                    registers[ip->a] = registers[ip->b] == registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(NotEqual) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs != rhs; })) {
+                    registers[ip->a] = registers[ip->b] != registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(Less) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs < rhs; })) {
+                    registers[ip->a] = registers[ip->b] < registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(LessEqual) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs <= rhs; })) {
+                    registers[ip->a] = registers[ip->b] <= registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(Greater) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs > rhs; })) {
+                    registers[ip->a] = registers[ip->b] > registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(GreaterEqual) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs >= rhs; })) {
+                    registers[ip->a] = registers[ip->b] >= registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(And) {
+                registers[ip->a] = registers[ip->b] && registers[ip->c];
+                VM_NEXT();
+            }
+            VM_CASE(Or) {
+                registers[ip->a] = registers[ip->b] || registers[ip->c];
+                VM_NEXT();
+            }
+            VM_CASE(Not) {
+                registers[ip->a] = !registers[ip->b];
+                VM_NEXT();
+            }
+            VM_CASE(Increment) {
+                registers[ip->a] = ++registers[ip->b];
+                VM_NEXT();
+            }
+            VM_CASE(Decrement) {
+                registers[ip->a] = --registers[ip->b];
+                VM_NEXT();
+            }
+            VM_CASE(Jump) {
+                VM_JUMP(ip->a);
+            }
+            VM_CASE(JumpIfFalse) {
+                if (!Condition(registers[ip->a], ip->line)) {
+                    VM_JUMP(ip->b);
+                }
+                VM_NEXT();
+            }
+            VM_CASE(JumpIfTrue) {
+                if (Condition(registers[ip->a], ip->line)) {
+                    VM_JUMP(ip->b);
+                }
+                VM_NEXT();
+            }
+            VM_CASE(ForPrepare) {
+                Value& from = registers[ip->a];
+                Value& to = registers[ip->a + 1];
+                if (!IsNumber(from) || !IsNumber(to)) {
+                    throw InterpreterException("Range bounds must be numbers.", ip->line);
+                }
+
+                // Loops over integral bounds count with integers
+                from = Integral(ToNumber(from));
+                Value last = Integral(ToNumber(to));
+                if (std::holds_alternative<Integer>(from) && std::holds_alternative<Integer>(last)) {
+                    Integer step = std::get<Integer>(from) < std::get<Integer>(last) ? 1 : -1;
+                    to = ip->b ? std::get<Integer>(last) + step : std::get<Integer>(last);
+                    registers[ip->a + 2] = step;
+                } else {
+                    from = ToNumber(from);
+                    double step = ToNumber(from) < ToNumber(to) ? 1 : -1;
+                    to = ip->b ? ToNumber(to) + step : ToNumber(to);
+                    registers[ip->a + 2] = step;
+                }
+                VM_NEXT();
+            }
+            VM_CASE(ForTest) {
+                if (Past(registers + ip->a)) {
+                    VM_JUMP(ip->b);
+                }
+                VM_NEXT();
+            }
+            VM_CASE(ForStep) {
+                Step(registers + ip->a);
+                VM_NEXT();
+            }
+            VM_CASE(Call) {
+                const CompiledFunction& callee = program.Load(program.functions[ip->b]);
+                if (Recall(callee, registers + ip->c, key, result)) {
+                    registers[ip->a] = std::move(result);
+                    VM_NEXT();
+                }
+                const NativeFunction* native = Native(callee);
+                if (native && Numbers(registers + ip->c, callee.arguments)) {
+                    registers[ip->a] = Invoke(callee, native, registers + ip->c);
+                    if (!key.empty()) {
+                        callee.memo->Insert(std::move(key), registers[ip->a]);
+                    }
+                    VM_NEXT();
+                }
+                Enter(ip->line);
+                frames.push_back({ function, ip, registers, references, key.empty() ? nullptr : &callee, std::move(key) });
+                enter(callee, frames.size(), registers + ip->c);
+                VM_DISPATCH();
+            }
+            VM_CASE(CallExternal) {
+                registers[ip->a] = CallExternal(program.functions[ip->b], registers + ip->c);
+                VM_NEXT();
+            }
+            VM_CASE(Spawn) {
+                registers[ip->a] = Spawn(program.functions[ip->b], registers + ip->c);
+                VM_NEXT();
+            }
+            VM_CASE(Await) {
+                registers[ip->a] = Await(registers[ip->b], ip->line);
+                VM_NEXT();
+            }
+            VM_CASE(Yield) {
+                // Only the generator a run was entered with is suspended, calls of generators
+                // from scripts are collected by runs of their own
+                if (!frames.empty() || !resume) {
+                    throw InterpreterException("Yield outside of a generator.", ip->line);
+                }
+                result = registers[ip->b];
+                registers[ip->a] = Value();
+                *resume = static_cast<unsigned>(ip - code) + 1;
+                return result;
+            }
+            VM_CASE(Collect) {
+                registers[ip->a] = Collect(program.functions[ip->b], registers + ip->c);
+                VM_NEXT();
+            }
+            VM_CASE(TailCall) {
+                // Arguments are in temporaries above the arguments of the function they replace
+                const CompiledFunction& callee = program.Load(program.functions[ip->b]);
+                if (&callee == function) {
+                    std::move(registers + ip->c, registers + ip->c + callee.arguments, registers);
+                    VM_JUMP(0);
+                }
+                if (Recall(callee, registers + ip->c, key, result)) {
+                    goto Returned;
+                }
+                const NativeFunction* native = Native(callee);
+                if (native && Numbers(registers + ip->c, callee.arguments)) {
+                    result = Invoke(callee, native, registers + ip->c);
+                    if (!key.empty()) {
+                        callee.memo->Insert(std::move(key), result);
+                    }
+                    goto Returned;
+                }
+                // A result to remember is stored when the callee returns, so the frame is kept
+                if (!key.empty()) {
+                    Enter(ip->line);
+                    frames.push_back({ function, ip, registers, references, &callee, std::move(key) });
+                    enter(callee, frames.size(), registers + ip->c);
+                    VM_DISPATCH();
+                }
+                // Registers of the frame are reused so the arguments are moved out of them first
+                arguments.assign(std::make_move_iterator(registers + ip->c), std::make_move_iterator(registers + ip->c + callee.arguments));
+                enter(callee, frames.size(), arguments.data());
+                VM_DISPATCH();
+            }
+            VM_CASE(Return) {
+                result = std::move(registers[ip->a]);
+                goto Returned;
+            }
+            VM_CASE(ReturnVoid) {
+                result = Value();
+                goto Returned;
+            }
+            VM_CASE(NewObject) {
+                const auto& layout = program.layouts[ip->b];
+                std::map<std::string, Value> values;
+                for (size_t i = 0; i < layout.size(); ++i) {
+                    values.emplace(layout[i], registers[ip->c + i]);
+                }
+                registers[ip->a] = Object(std::move(values));
+                VM_NEXT();
+            }
+            VM_CASE(NewArray) {
+                // Typed elements can still hold other values, the array keeps values then
+                if (ip->d && Numbers(registers + ip->b, ip->c)) {
+                    std::vector<double> numbers(ip->c);
+                    for (unsigned i = 0; i < ip->c; ++i) {
+                        numbers[i] = ToNumber(registers[ip->b + i]);
+                    }
+                    registers[ip->a] = Array(std::move(numbers));
+                    VM_NEXT();
+                }
+                std::vector<Value> values(registers + ip->b, registers + ip->b + ip->c);
+                registers[ip->a] = Array(std::move(values));
+                VM_NEXT();
+            }
+            VM_CASE(RefRegister) {
+                references[ip->a] = &registers[ip->b];
+                VM_NEXT();
+            }
+            VM_CASE(RefField) {
+                Object* object = std::get_if<Object>(references[ip->b]);
+                if (!object) {
+                    throw InterpreterException("Can't call an dot operator on non object type.", ip->line);
+                }
+                references[ip->a] = &object->values[std::get<std::string>(constants[ip->c])];
+                VM_NEXT();
+            }
+            VM_CASE(RefIndex) {
+                // Elements of packed arrays have no value to refer to, so the array is unpacked
+                if (Array* array = std::get_if<Array>(references[ip->b])) {
+                    size_t position = Element(*array, registers[ip->c], ip->line);
+                    array->Unpack();
+                    references[ip->a] = &array->values[position];
+                    VM_NEXT();
+                }
+                references[ip->a] = &Entry(references[ip->b], registers[ip->c], ip->line);
+                VM_NEXT();
+            }
+            VM_CASE(LoadIndex) {
+                if (const Array* array = std::get_if<Array>(references[ip->b])) {
+                    Value value = array->At(Element(*array, registers[ip->c], ip->line));
+                    registers[ip->a] = std::move(value);
+                    VM_NEXT();
+                }
+                Value value = Entry(references[ip->b], registers[ip->c], ip->line);
+                registers[ip->a] = std::move(value);
+                VM_NEXT();
+            }
+            VM_CASE(StoreIndex) {
+                if (Array* array = std::get_if<Array>(references[ip->a])) {
+                    size_t position = Element(*array, registers[ip->b], ip->line);
+                    // Other chunks of a parallel loop write the same array, it can't be unpacked
+                    if (array->packed && !IsNumber(registers[ip->c]) && ip->a < function->shared) {
+                        throw InterpreterException("Parallel loop can't store a value other than a number into an array of numbers.", ip->line);
+                    }
+                    array->Set(position, registers[ip->c]);
+                    VM_NEXT();
+                }
+                Value value = registers[ip->c];
+                Entry(references[ip->a], registers[ip->b], ip->line) = std::move(value);
+                VM_NEXT();
+            }
+            VM_CASE(ParallelFor) {
+                Parallel(program.functions[ip->b], registers + ip->a, registers + ip->c, references + ip->d);
+                VM_NEXT();
+            }
+            VM_CASE(Push) {
+                Array* array = std::get_if<Array>(&registers[ip->a]);
+                if (!array) {
+                    throw InterpreterException("Can't append to non array type.", ip->line);
+                }
+                array->Push(registers[ip->b]);
+                VM_NEXT();
+            }
+            VM_CASE(Load) {
+                // Referenced value may be owned by the destination register so it is copied first
+                Value value = *references[ip->b];
+                registers[ip->a] = std::move(value);
+                VM_NEXT();
+            }
+            VM_CASE(Store) {
+                Value value = registers[ip->b];
+                *references[ip->a] = std::move(value);
+                VM_NEXT();
+            }
+            VM_CASE(Fail) {
+                throw InterpreterException(std::get<std::string>(constants[ip->a]), ip->line);
+            }
+            VM_CASE(LoadFieldChain) {
+                Value value = Field(registers[ip->b], function->paths[ip->c], ip->line);
+                registers[ip->a] = std::move(value);
+                VM_NEXT();
+            }
+            VM_CASE(EqualField) {
+                registers[ip->a] = Field(registers[ip->b], function->paths[ip->c], ip->line) == registers[ip->d];
+                VM_NEXT();
+            }
+            VM_CASE(AddConstant) {
+                if (!Integers(registers[ip->a], registers[ip->b], constants[ip->c], [](Integer lhs, Integer rhs) { return IntegerResult(lhs + rhs); })
+                    && !(ip->a == ip->b && Append(registers[ip->a], constants[ip->c]))
+                    && !Same<std::string>(registers[ip->a], registers[ip->b], constants[ip->c], [](const std::string& lhs, const std::string& rhs) { return lhs + rhs; })) {
+                    registers[ip->a] = registers[ip->b] + constants[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(SubtractConstant) {
+                if (!Integers(registers[ip->a], registers[ip->b], constants[ip->c], [](Integer lhs, Integer rhs) { return IntegerResult(lhs - rhs); })) {
+                    registers[ip->a] = registers[ip->b] - constants[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(ForLoop) {
+                if (Integer* counter = std::get_if<Integer>(&registers[ip->a])) {
+                    Integer step = std::get<Integer>(registers[ip->a + 2]);
+                    *counter += step;
+                    if (step > 0 ? *counter < std::get<Integer>(registers[ip->a + 1]) : *counter > std::get<Integer>(registers[ip->a + 1])) {
+                        registers[ip->c] = *counter;
+                        VM_JUMP(ip->b);
+                    }
+                    VM_NEXT();
+                }
+                double& counter = std::get<double>(registers[ip->a]);
+                double step = std::get<double>(registers[ip->a + 2]);
+                counter += step;
+                if (step > 0 ? counter < std::get<double>(registers[ip->a + 1]) : counter > std::get<double>(registers[ip->a + 1])) {
+                    registers[ip->c] = counter;
+                    VM_JUMP(ip->b);
+                }
+                VM_NEXT();
+            }
+            VM_CASE(AddNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return IntegerResult(lhs + rhs); })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs + rhs; })) {
+                    registers[ip->a] = registers[ip->b] + registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(SubtractNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return IntegerResult(lhs - rhs); })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs - rhs; })) {
+                    registers[ip->a] = registers[ip->b] - registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(MultiplyNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return Interpreter::Multiply(lhs, rhs); })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs * rhs; })) {
+                    registers[ip->a] = registers[ip->b] * registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(DivideNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return Interpreter::Divide(lhs, rhs); })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs / rhs; })) {
+                    registers[ip->a] = registers[ip->b] / registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(EqualNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs == rhs; })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs == rhs; })) {
+                    registers[ip->a] = registers[ip->b] == registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(NotEqualNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs != rhs; })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs != rhs; })) {
+                    registers[ip->a] = registers[ip->b] != registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(LessNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs < rhs; })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs < rhs; })) {
+                    registers[ip->a] = registers[ip->b] < registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(LessEqualNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs <= rhs; })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs <= rhs; })) {
+                    registers[ip->a] = registers[ip->b] <= registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(GreaterNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs > rhs; })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs > rhs; })) {
+                    registers[ip->a] = registers[ip->b] > registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(GreaterEqualNumber) {
+                if (!Integers(registers[ip->a], registers[ip->b], registers[ip->c], [](Integer lhs, Integer rhs) { return lhs >= rhs; })
+                    && !Same<double>(registers[ip->a], registers[ip->b], registers[ip->c], [](double lhs, double rhs) { return lhs >= rhs; })) {
+                    registers[ip->a] = registers[ip->b] >= registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(AddString) {
+                if (!(ip->a == ip->b && Append(registers[ip->a], registers[ip->c]))
+                    && !Same<std::string>(registers[ip->a], registers[ip->b], registers[ip->c], [](const std::string& lhs, const std::string& rhs) { return lhs + rhs; })) {
+                    registers[ip->a] = registers[ip->b] + registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(EqualString) {
+                if (!Same<std::string>(registers[ip->a], registers[ip->b], registers[ip->c], [](const std::string& lhs, const std::string& rhs) { return lhs == rhs; })) {
+                    registers[ip->a] = registers[ip->b] == registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(NotEqualString) {
+                if (!Same<std::string>(registers[ip->a], registers[ip->b], registers[ip->c], [](const std::string& lhs, const std::string& rhs) { return lhs != rhs; })) {
+                    registers[ip->a] = registers[ip->b] != registers[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(EqualConstant) {
+                if (!Same<std::string>(registers[ip->a], registers[ip->b], constants[ip->c], [](const std::string& lhs, const std::string& rhs) { return lhs == rhs; })) {
+                    registers[ip->a] = registers[ip->b] == constants[ip->c];
+                }
+                VM_NEXT();
+            }
+            VM_CASE(NotEqualConstant) {
+                if (!Same<std::string>(registers[ip->a], registers[ip->b], constants[ip->c], [](const std::string& lhs, const std::string& rhs) { return lhs != rhs; })) {
+                    registers[ip->a] = registers[ip->b] != constants[ip->c];
+                }
+                VM_NEXT();
+            }
+            default:
+                throw InterpreterException("Unknown operation.", ip->line);
+            Returned:
+                if (frames.empty()) {
+                    return result;
+                }
+                --depth;
+                if (frames.back().memoized) {
+                    frames.back().memoized->memo->Insert(std::move(frames.back().key), result);
+                }
+                function = frames.back().function;
+                code = function->code.data();
+                constants = function->constants.data();
+                ip = frames.back().ip;
+                registers = frames.back().registers;
+                references = frames.back().references;
+                frames.pop_back();
+                registers[ip->a] = std::move(result);
+                VM_NEXT();
+            }
+        } catch (const InternalException& err) {
+            throw InterpreterException(err.what(), ip->line);
+        }
+    }
+
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_JUMP
+#if INTERPRETER_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+    static bool Numbers(const Value* values, unsigned count) {
+        return std::all_of(values, values + count, [](const Value& value) { return IsNumber(value); });
+    }
+
+    // Element of an object indexed by its key
+    static Value& Entry(Value* value, const Value& index, unsigned line) {
+        Object* object = std::get_if<Object>(value);
+        if (!object) {
+            throw InterpreterException("Can't call an index operator on non object or array type.", line);
+        }
+        const std::string* key = std::get_if<std::string>(&index);
+        if (!key) {
+            throw InterpreterException("Can't call an index operator with non string type.", line);
+        }
+        auto it = object->values.find(*key);
+        if (it == object->values.end()) {
+            throw InterpreterException("Object does not contain key " + *key + ".", line);
+        }
+        return it->second;
+    }
+
+    // Position of an element of an array, indices are numbers that are never converted to text
+    static size_t Element(const Array& array, const Value& index, unsigned line) {
+        size_t position = array.Position(index);
+        if (position == array.Size()) {
+            if (!IsNumber(index)) {
+                throw InterpreterException("Can't index an array with non number type.", line);
+            }
+            throw InterpreterException("Index " + ToString(index) + " is out of bounds of array of size " + std::to_string(array.Size()) + ".", line);
+        }
+        return position;
+    }
+
+    // Reads a chain of dot operators without inserting missing keys
+    static const Value& Field(const Value& value, const std::vector<std::string>& path, unsigned line) {
+        static const Value missing;
+        const Value* current = &value;
+        for (const auto& key : path) {
+            const Object* object = std::get_if<Object>(current);
+            if (!object) {
+                throw InterpreterException("Can't call an dot operator on non object type.", line);
+            }
+            auto it = object->values.find(key);
+            if (it == object->values.end()) {
+                return missing;
+            }
+            current = &it->second;
+        }
+        return *current;
+    }
+
+    // Operations on two values of the same type are done directly without visiting the generic operators
+    template <typename T, typename Operation>
+    static bool Same(Value& result, const Value& lhs, const Value& rhs, Operation operation) {
+        const T* lhsValue = std::get_if<T>(&lhs);
+        const T* rhsValue = std::get_if<T>(&rhs);
+        if (!lhsValue || !rhsValue) {
+            return false;
+        }
+        result = operation(*lhsValue, *rhsValue);
+        return true;
+    }
+
+    // Concatenation whose result replaces its left operand, e.g. text = +(text, piece), appends in
+    // place. Registers own their values so the string is never shared and building it in a loop
+    // takes amortized linear time instead of copying it on every step.
+    static bool Append(Value& lhs, const Value& rhs) {
+        std::string* text = std::get_if<std::string>(&lhs);
+        const std::string* piece = std::get_if<std::string>(&rhs);
+        if (!text || !piece) {
+            return false;
+        }
+        text->append(*piece);
+        return true;
+    }
+
+    template <typename Operation>
+    static bool Integers(Value& result, const Value& lhs, const Value& rhs, Operation operation) {
+        return Same<Integer>(result, lhs, rhs, operation);
+    }
+
+    // Counter, limit and step of a for loop are all integers or all doubles
+    static bool Past(const Value* loop) {
+        if (const Integer* counter = std::get_if<Integer>(&loop[0])) {
+            return std::get<Integer>(loop[2]) > 0 ? *counter >= std::get<Integer>(loop[1]) : *counter <= std::get<Integer>(loop[1]);
+        }
+        double counter = std::get<double>(loop[0]);
+        return std::get<double>(loop[2]) > 0 ? counter >= std::get<double>(loop[1]) : counter <= std::get<double>(loop[1]);
+    }
+
+    static void Step(Value* loop) {
+        if (Integer* counter = std::get_if<Integer>(&loop[0])) {
+            *counter += std::get<Integer>(loop[2]);
+            return;
+        }
+        std::get<double>(loop[0]) += std::get<double>(loop[2]);
+    }
+
+    // Runs the call on the thread pool in a machine of its own, the arguments are copied into the
+    // task as into any call. When profiling the call runs right away on this machine.
+    Value Spawn(const CompiledFunction& callee, const Value* arguments) {
+        if (!tasks) {
+            tasks = std::make_shared<Tasks>();
+        }
+        Task* task;
+        Integer handle;
+        {
+            std::lock_guard<std::mutex> lock(tasks->mutex);
+            handle = static_cast<Integer>(tasks->started.size());
+            task = &tasks->started.emplace_back();
+        }
+
+        std::vector<Value> values(arguments, arguments + callee.arguments);
+        auto run = [&callee, task](VirtualMachine& vm, std::vector<Value>& values) {
+            try {
+                task->result = vm.Invoke(callee, values.data());
+            } catch (...) {
+                task->error = std::current_exception();
+            }
+            task->done = true;
+        };
+        if (profile) {
+            run(*this, values);
+            return handle;
+        }
+
+        ++tasks->running;
+        // The spawning machine may be gone once the task starts, the program stays until the top
+        // level call joins its tasks
+        ThreadPool::Instance().Submit([&program = program, dispatch = dispatch, output = output, run, values = std::move(values), shared = tasks]() mutable {
+            Output::Scope scope(*output);
+            VirtualMachine vm(program, dispatch, nullptr, output);
+            vm.tasks = shared;
+            run(vm, values);
+            --shared->running;
+        });
+        return handle;
+    }
+
+    // Threads waiting for the task run other queued tasks meanwhile, so awaiting a task that has
+    // not started yet runs it on the waiting thread
+    Value Await(const Value& handle, unsigned line) {
+        Task* task = nullptr;
+        if (IsNumber(handle) && tasks) {
+            // Handles kept in number arrays come back as doubles
+            double index = ToNumber(handle);
+            std::lock_guard<std::mutex> lock(tasks->mutex);
+            if (index >= 0 && index < static_cast<double>(tasks->started.size()) && index == std::floor(index)) {
+                task = &tasks->started[static_cast<size_t>(index)];
+            }
+        }
+        if (!task) {
+            throw InterpreterException("Only a handle returned by spawn can be awaited.", line);
+        }
+
+        ThreadPool::Instance().Wait([task]() { return task->done.load(); });
+        task->awaited = true;
+        if (task->error) {
+            std::rethrow_exception(task->error);
+        }
+        return task->result;
+    }
+
+    // Waits for all spawned tasks and forgets them, the first error of a task no one awaited is
+    // rethrown when raise is set
+    void Finish(bool raise) {
+        if (!tasks) {
+            return;
+        }
+        std::shared_ptr<Tasks> finished = std::move(tasks);
+        ThreadPool::Instance().Wait([&]() { return finished->running == 0; });
+        if (!raise) {
+            return;
+        }
+        for (const Task& task : finished->started) {
+            if (task.error && !task.awaited.load()) {
+                std::rethrow_exception(task.error);
+            }
+        }
+    }
+
+    // Splits the range into a few chunks per thread of the pool, each chunk runs in a virtual
+    // machine of its own. Without threads to spread over, or when profiling, the whole range runs
+    // as a single chunk on this one.
+    void Parallel(const CompiledFunction& body, const Value* loop, const Value* copied, Value* const* shared) {
+        size_t count = Iterations(loop);
+        auto run = [&](VirtualMachine& vm, size_t begin, size_t end) {
+            std::vector<Value> registers(body.registers);
+            registers[0] = Counter(loop, begin);
+            registers[1] = Counter(loop, end);
+            registers[2] = loop[2];
+            std::copy(copied, copied + body.arguments - 3, registers.begin() + 3);
+            vm.Interpret(body, registers.data(), 0, shared);
+        };
+
+        ThreadPool& pool = ThreadPool::Instance();
+        size_t chunks = std::min(count, pool.Size() * 4);
+        if (profile || chunks < 2) {
+            run(*this, 0, count);
+            return;
+        }
+        pool.Run(chunks, [&](size_t chunk) {
+            Output::Scope scope(*output);
+            VirtualMachine vm(program, dispatch, nullptr, output);
+            run(vm, chunk * count / chunks, (chunk + 1) * count / chunks);
+        });
+    }
+
+    static size_t Iterations(const Value* loop) {
+        if (const Integer* counter = std::get_if<Integer>(&loop[0])) {
+            Integer count = (std::get<Integer>(loop[1]) - *counter) * std::get<Integer>(loop[2]);
+            return count > 0 ? static_cast<size_t>(count) : 0;
+        }
+        double count = std::ceil((std::get<double>(loop[1]) - std::get<double>(loop[0])) * std::get<double>(loop[2]));
+        return count > 0 ? static_cast<size_t>(count) : 0;
+    }
+
+    // Counter of the loop after the given count of iterations
+    static Value Counter(const Value* loop, size_t iterations) {
+        if (const Integer* counter = std::get_if<Integer>(&loop[0])) {
+            return *counter + static_cast<Integer>(iterations) * std::get<Integer>(loop[2]);
+        }
+        return std::get<double>(loop[0]) + static_cast<double>(iterations) * std::get<double>(loop[2]);
+    }
+
+    static bool Condition(const Value& value, unsigned line) {
+        const bool* condition = std::get_if<bool>(&value);
+        if (!condition) {
+            throw InterpreterException("Condition must be of type bool.", line);
+        }
+        return *condition;
+    }
+};
+
+// Values of a generator function taken one at a time by the host. The frame of the generator
+// lives in the generator between the values, so each one is computed only once it is asked for
+// and a sequence of any length takes constant memory. The program must outlive the generator.
+class Generator {
+    VirtualMachine vm;
+    const CompiledFunction& function;
+    std::vector<Value> registers;
+    unsigned resume = 0;
+    bool finished = false;
+
+public:
+    class Iterator {
+        Generator* generator = nullptr;
+        Value value;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Value*;
+        using reference = const Value&;
+
+        Iterator() = default;
+        explicit Iterator(Generator& generator)
+            : generator(&generator) {
+            ++*this;
+        }
+
+        const Value& operator*() const { return value; }
+        const Value* operator->() const { return &value; }
+
+        Iterator& operator++() {
+            if (!generator->Next(value)) {
+                generator = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return generator == other.generator; }
+        bool operator!=(const Iterator& other) const { return generator != other.generator; }
+    };
+
+    Generator(const Program& program, const std::string& name, const std::list<Value>& arguments, Dispatch dispatch = Dispatch::Threaded, Output* output = nullptr)
+        : vm(program, dispatch, nullptr, output), function(program.Load(program.GetFunction(name))) {
+        if (!function.generator) {
+            throw InterpreterException("Function " + name + " is not a generator.", function.line);
+        }
+        registers = VirtualMachine::Arguments(function, arguments);
+        registers.resize(function.registers);
+    }
+
+    // Resumes the generator until it yields its next value, returns false once it has finished
+    bool Next(Value& value) {
+        if (finished) {
+            return false;
+        }
+        Output::Scope scope(*vm.output);
+        VirtualMachine::Flush flush{ *vm.output };
+        VirtualMachine::Join join{ vm };
+
+        // A generator that failed can't be resumed
+        finished = true;
+        unsigned start = resume;
+        resume = 0;
+        Value result = vm.Interpret(function, registers.data(), start, nullptr, &resume);
+        vm.Finish(true);
+        if (!resume) {
+            return false;
+        }
+        finished = false;
+        Normalize(result);
+        value = std::move(result);
+        return true;
+    }
+
+    Iterator begin() { return Iterator(*this); }
+    Iterator end() { return Iterator(); }
+};
+
+} // namespace Interpreter
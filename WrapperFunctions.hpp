@@ -2,21 +2,119 @@
 
 #include <string>
 #include <iostream>
+#include <mutex>
 
 #include "Helpers.hpp"
 
 namespace Interpreter {
-    void Write(const Value& string) {
-        std::cout << ToString(string);
+    // Destination of Write and WriteLine. Text is collected in a buffer and passed to the target
+    // stream once the buffer is full, before input is read, when a call from the host returns and
+    // when flushed explicitly, so scripts writing many lines don't flush the stream on every one.
+    // Each parser has an output of its own, made current on the threads evaluating its calls.
+    class Output {
+        std::ostream* target;
+        std::string buffer;
+        size_t capacity;
+        std::mutex mutex;
+
+        inline static thread_local Output* current = nullptr;
+
+        void FlushLocked() {
+            target->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            target->flush();
+            buffer.clear();
+        }
+
+    public:
+        // Text still buffered on destruction is dropped, the target may be gone by then
+        explicit Output(std::ostream& target = std::cout, size_t capacity = 1 << 16)
+            : target(&target), capacity(capacity) {}
+
+        Output(const Output&) = delete;
+        Output& operator=(const Output&) = delete;
+
+        // Output of calls evaluated on this thread, outside of them writes go unbuffered to the
+        // standard output
+        static Output& Current() {
+            static Output standard(std::cout, 0);
+            return current ? *current : standard;
+        }
+
+        // Makes output current on this thread while the scope lasts
+        class Scope {
+            Output* previous;
+
+        public:
+            explicit Scope(Output& output) : previous(current) { current = &output; }
+            ~Scope() { current = previous; }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        };
+
+        // Writes buffered text to the current target and sends further output to stream, e.g. a
+        // file or a string stream
+        void Redirect(std::ostream& stream) {
+            std::lock_guard<std::mutex> lock(mutex);
+            FlushLocked();
+            target = &stream;
+        }
+
+        // Size of the buffer in characters, zero passes every write to the target right away
+        void Capacity(size_t size) {
+            std::lock_guard<std::mutex> lock(mutex);
+            capacity = size;
+            if (buffer.size() >= capacity) {
+                FlushLocked();
+            }
+        }
+
+        void Flush() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!buffer.empty()) {
+                FlushLocked();
+            }
+        }
+
+        void Write(const Value& value, bool line) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (const double* number = std::get_if<double>(&value)) {
+                AppendNumber(buffer, *number);
+            } else if (const Integer* integer = std::get_if<Integer>(&value)) {
+                AppendNumber(buffer, static_cast<double>(*integer));
+            } else if (const std::string* string = std::get_if<std::string>(&value)) {
+                buffer += *string;
+            } else {
+                buffer += ToString(value);
+            }
+            if (line) {
+                buffer += '\n';
+            }
+            if (buffer.size() >= capacity) {
+                FlushLocked();
+            }
+        }
+    };
+
+    inline void Write(const Value& string) {
+        Output::Current().Write(string, false);
     }
 
-    void WriteLine(const Value& string) {
-        std::cout << ToString(string) << std::endl;
+    inline void WriteLine(const Value& string) {
+        Output::Current().Write(string, true);
     }
 
-    double ReadNumber() {
+    // Tasks may read input concurrently, each of them gets whole lines
+    inline std::string ReadLine() {
+        static std::mutex mutex;
+        Output::Current().Flush();
+        std::lock_guard<std::mutex> lock(mutex);
         std::string read;
         std::getline(std::cin, read);
+        return read;
+    }
+
+    inline double ReadNumber() {
+        std::string read = ReadLine();
         try {
             return std::stod(read);
         } catch (const std::invalid_argument&) {
@@ -24,9 +122,7 @@ namespace Interpreter {
         }
     }
 
-    std::string ReadText() {
-        std::string read;
-        std::getline(std::cin, read);
-        return read;
+    inline std::string ReadText() {
+        return ReadLine();
     }
 }
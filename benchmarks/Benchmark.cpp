@@ -0,0 +1,84 @@
+#include "../Interpreter"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+using namespace Interpreter;
+
+namespace {
+
+struct Benchmark {
+    string name;
+    string function;
+    list<Value> arguments;
+};
+
+const vector<Benchmark> benchmarks = {
+    { "ForLoop", "foo", { 2000000.0 } },
+    { "WhileLoop", "foo", { 2000000.0, 3.0 } },
+    { "FunctionRecursiveCall", "Fibonacci", { 24.0 } },
+    { "EqualityOperator", "foo", { 500000.0 } },
+    { "DotOperatorChaining", "foo", { 500000.0 } },
+    { "LogicalOperators", "foo", { 1000000.0 } },
+    { "FieldComparison", "foo", { 500000.0 } },
+    { "StringConcatenation", "foo", { 1000000.0 } },
+    { "ParallelFor", "foo", { 20000.0 } },
+};
+
+double Measure(const Parser& parser, const Benchmark& benchmark, Dispatch dispatch, std::string& result) {
+    VirtualMachine vm(parser.Bytecode(), dispatch);
+    auto start = chrono::steady_clock::now();
+    result = ToString(vm.Call(benchmark.function, benchmark.arguments));
+    auto time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return time;
+}
+
+CompilerOptions Options(bool optimized, unsigned jitThreshold) {
+    CompilerOptions options;
+    options.superinstructions = optimized;
+    options.specialization = optimized;
+    options.folding = optimized;
+    options.hoisting = optimized;
+    options.inlineBudget = optimized ? options.inlineBudget : 0;
+    options.jitThreshold = jitThreshold;
+    return options;
+}
+
+} // namespace
+
+// Compares switch and threaded dispatch of the virtual machine, threaded dispatch of bytecode with
+// superinstructions, type specialized instructions, folded constants, inlined functions and hoisted loop invariants and machine code compiled on the first call on scaled up evaluator examples.
+// Optional arguments filter benchmarks by name.
+int main(int argc, char* argv[]) {
+    cout << left << setw(24) << "Benchmark" << right << setw(14) << "Switch (ms)" << setw(16) << "Threaded (ms)" << setw(10) << "Speedup"
+         << setw(13) << "Fused (ms)" << setw(10) << "Speedup" << setw(11) << "JIT (ms)" << setw(10) << "Speedup" << "\n";
+    for (const auto& benchmark : benchmarks) {
+        if (argc > 1 && find(argv + 1, argv + argc, benchmark.name) == argv + argc) {
+            continue;
+        }
+
+        Parser parser("examples/benchmark/" + benchmark.name + ".ct", Options(false, 0));
+        Parser fusedParser("examples/benchmark/" + benchmark.name + ".ct", Options(true, 0));
+        Parser jitParser("examples/benchmark/" + benchmark.name + ".ct", Options(true, 1));
+        string switchResult;
+        string threadedResult;
+        string fusedResult;
+        string jitResult;
+        double switchTime = Measure(parser, benchmark, Dispatch::Switch, switchResult);
+        double threadedTime = Measure(parser, benchmark, Dispatch::Threaded, threadedResult);
+        double fusedTime = Measure(fusedParser, benchmark, Dispatch::Threaded, fusedResult);
+        double jitTime = Measure(jitParser, benchmark, Dispatch::Threaded, jitResult);
+        if (switchResult != threadedResult || switchResult != fusedResult || switchResult != jitResult) {
+            cerr << benchmark.name << " returned different results " << switchResult << ", " << threadedResult << ", " << fusedResult << " and " << jitResult << "." << endl;
+            return -1;
+        }
+
+        cout << left << setw(24) << benchmark.name << right << fixed << setprecision(2)
+             << setw(14) << switchTime << setw(16) << threadedTime << setw(9) << switchTime / threadedTime << "x"
+             << setw(13) << fusedTime << setw(9) << switchTime / fusedTime << "x"
+             << setw(11) << jitTime << setw(9) << switchTime / jitTime << "x\n";
+    }
+    return 0;
+}
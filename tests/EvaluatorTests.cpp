@@ -1,6 +1,7 @@
 #include "catch.hpp"
 
 #include "../Interpreter"
+#include "../Library.hpp"
 
 using namespace std;
 using namespace Interpreter;
@@ -174,4 +175,491 @@ TEST_CASE("Index operator object access") {
     CHECK(ToString(p.Evaluate("foo", { "a"s })) == "{ a: { value: \"a\", }, b: { value: \"aWorld\", }, }");
 }
 
+TEST_CASE("Switch and threaded dispatch") {
+    Parser p("examples/evaluator/FunctionRecursiveCall.ct");
+    INFO(p.Bytecode());
+    CHECK(ToString(VirtualMachine(p.Bytecode(), Dispatch::Switch).Call("Factorial", { 4.0 })) == "24");
+    CHECK(ToString(VirtualMachine(p.Bytecode(), Dispatch::Threaded).Call("Factorial", { 4.0 })) == "24");
+
+    Parser q("examples/evaluator/WhileLoop.ct");
+    INFO(q.Bytecode());
+    CHECK(ToString(VirtualMachine(q.Bytecode(), Dispatch::Switch).Call("foo", { 5.0, 5.0 })) == "25");
+    CHECK(ToString(VirtualMachine(q.Bytecode(), Dispatch::Threaded).Call("foo", { 5.0, 5.0 })) == "25");
+
+    Parser r("examples/evaluator/IndexOperator.ct");
+    INFO(r.Bytecode());
+    CHECK(ToString(VirtualMachine(r.Bytecode(), Dispatch::Switch).Call("foo", { "a"s })) == "{ a: { value: \"a\", }, b: { value: \"aWorld\", }, }");
+}
+
+TEST_CASE("Superinstructions") {
+    for (const auto& [file, argument, expected] : { std::tuple{ "ForLoop", Value(5.0), "14" }, { "ForLoop", Value(-3.0), "-3" }, { "DotOperatorChaining", Value("Hello"s), "{ a: { value: \"Hello\", }, b: { value: \"HelloWorld\", }, }" } }) {
+        Parser plain("examples/evaluator/"s + file + ".ct", { false });
+        Parser fused("examples/evaluator/"s + file + ".ct");
+        INFO(fused.Bytecode());
+
+        Profile plainProfile;
+        Profile fusedProfile;
+        CHECK(ToString(VirtualMachine(plain.Bytecode(), Dispatch::Threaded, &plainProfile).Call("foo", { argument })) == expected);
+        CHECK(ToString(VirtualMachine(fused.Bytecode(), Dispatch::Threaded, &fusedProfile).Call("foo", { argument })) == expected);
+        CHECK(fusedProfile.Total() < plainProfile.Total());
+    }
+
+    CompilerOptions options;
+    options.hoisting = false;
+    Parser p("examples/benchmark/FieldComparison.ct", options);
+    INFO(p.Bytecode());
+    Profile profile;
+    CHECK(ToString(VirtualMachine(p.Bytecode(), Dispatch::Switch, &profile).Call("foo", { 10.0 })) == "0");
+    CHECK(profile.Count(OpCode::EqualField) == 30);
+    CHECK(profile.Count(OpCode::ForLoop) == 10);
+}
+
+TEST_CASE("Native code") {
+    CompilerOptions options;
+    options.jitThreshold = 1;
+    options.inlineBudget = 0;
+
+    Parser p("examples/evaluator/FunctionRecursiveCall.ct", options);
+    INFO(p.Bytecode());
+    CHECK(ToString(p.Evaluate("Factorial", { 5.0 })) == "120");
+    CHECK(ToString(p.Evaluate("Factorial", { true })) == "1");
+    CHECK(static_cast<bool>(p.Bytecode().GetFunction("Factorial").native) == INTERPRETER_JIT);
+
+    Parser q("examples/evaluator/ForLoop.ct", options);
+    INFO(q.Bytecode());
+    CHECK(ToString(q.Evaluate("foo", { 5.0 })) == "14");
+    CHECK(ToString(q.Evaluate("foo", { -3.0 })) == "-3");
+    CHECK(ToString(q.Evaluate("foo", { 2.0 })) == "2");
+
+    Parser r("examples/evaluator/EqualityOperator.ct", options);
+    INFO(r.Bytecode());
+    CHECK(ToString(r.Evaluate("foo", { 2.0, 2.0 })) == "0");
+    CHECK(ToString(r.Evaluate("foo", { 3.0, 2.0 })) == "1");
+    CHECK(ToString(r.Evaluate("foo", { 1.0, 2.0 })) == "-1");
+    CHECK(ToString(r.Evaluate("foo", { 0.0 / 0.0, 2.0 })) == "-2");
+
+    Parser s("examples/evaluator/NativeBailout.ct", options);
+    INFO(s.Bytecode());
+    CHECK(ToString(s.Evaluate("foo", { 4.0 })) == "6");
+    CHECK(static_cast<bool>(s.Bytecode().GetFunction("foo").native) == INTERPRETER_JIT);
+    CHECK_FALSE(s.Bytecode().GetFunction("name").native);
+    CHECK_THROWS_AS(s.Evaluate("bar", { 4.0 }), InterpreterException);
+}
+
+TEST_CASE("Integer numbers") {
+    CHECK(std::holds_alternative<Integer>(Value(Integer(3)) + Value(Integer(4))));
+    CHECK(std::holds_alternative<double>(Value(Integer(3)) + Value(0.5)));
+    CHECK(std::holds_alternative<double>(Value(Integer(7)) / Value(Integer(2))));
+    CHECK(std::holds_alternative<double>(Value(MaxInteger) * Value(Integer(2))));
+    CHECK(std::holds_alternative<double>(Integral(-0.0)));
+    CHECK(Value(Integer(1)) == Value(1.0));
+    CHECK(Value(Integer(1)) < Value(1.5));
+
+    Parser p("examples/evaluator/IntegerNumbers.ct");
+    INFO(p.Bytecode());
+    Value counter = p.Evaluate("foo", { 4.0, 3.0 });
+    REQUIRE(std::holds_alternative<Object>(counter));
+    CHECK(std::holds_alternative<double>(std::get<Object>(counter).values["value"]));
+    CHECK(ToString(counter) == "{ value: 18, }");
+    CHECK(ToString(p.Evaluate("foo", { 2.5, 0.5 })) == "{ value: 1.5, }");
+    CHECK(ToString(p.Evaluate("half", { 7.0 })) == "3.5");
+    CHECK(std::holds_alternative<double>(p.Evaluate("half", { 8.0 })));
+    CHECK(ToString(p.Evaluate("negative", { 0.0 })) == "-0");
+    CHECK(ToString(p.Evaluate("negative", { 1e300 })) == "-1e+300");
+}
+
+TEST_CASE("Type specialized instructions") {
+    Parser p("examples/evaluator/TypedOperators.ct");
+    INFO(p.Bytecode());
+    Profile profile;
+    VirtualMachine vm(p.Bytecode(), Dispatch::Threaded, &profile);
+    CHECK(ToString(vm.Call("numbers", { 3.0, 2.0 })) == "7");
+    CHECK(ToString(vm.Call("numbers", { 1.5, 0.5 })) == "1.75");
+    CHECK(profile.Count(OpCode::MultiplyNumber) == 2);
+    CHECK(profile.Count(OpCode::AddNumber) == 2);
+    CHECK(ToString(vm.Call("strings", { "a"s, "b"s })) == "ab");
+    CHECK(ToString(vm.Call("strings", { "a"s, "a"s })) == "a");
+    CHECK(profile.Count(OpCode::EqualString) == 2);
+    CHECK(profile.Count(OpCode::AddString) == 1);
+
+    // Values of other types than the static ones use the generic operators
+    CHECK(ToString(vm.Call("strings", { 1.0, 2.0 })) == "3");
+    CHECK_THROWS_AS(vm.Call("numbers", { "a"s, "b"s }), InterpreterException);
+
+    CompilerOptions options;
+    options.specialization = false;
+    Parser q("examples/evaluator/TypedOperators.ct", options);
+    INFO(q.Bytecode());
+    Profile generic;
+    CHECK(ToString(VirtualMachine(q.Bytecode(), Dispatch::Threaded, &generic).Call("numbers", { 3.0, 2.0 })) == "7");
+    CHECK(generic.Count(OpCode::MultiplyNumber) == 0);
+    CHECK(generic.Count(OpCode::Multiply) == 1);
+}
+
+TEST_CASE("Constant folding") {
+    Parser p("examples/evaluator/ConstantFolding.ct");
+    INFO(p.Tree());
+    INFO(p.Bytecode());
+    Profile profile;
+    VirtualMachine vm(p.Bytecode(), Dispatch::Threaded, &profile);
+    CHECK(ToString(vm.Call("area", { 2.0 })) == "12");
+    CHECK(profile.Count(OpCode::MultiplyNumber) == 2);
+    CHECK(profile.Count(OpCode::DivideNumber) == 0);
+    CHECK(ToString(vm.Call("scale", { -0.0 })) == "-0");
+    CHECK(profile.Count(OpCode::SubtractNumber) == 0);
+    CHECK(ToString(vm.Call("describe", { true })) == "enabled");
+    CHECK(ToString(vm.Call("describe", { false })) == "disabled");
+    CHECK(profile.Count(OpCode::AddString) == 0);
+    CHECK(profile.Count(OpCode::JumpIfFalse) == 2);
+    CHECK(ToString(vm.Call("difference", { 5.0, 2.0 })) == "3");
+    CHECK(profile.Count(OpCode::DivideNumber) == 0);
+
+    // Typed variables holding values of other types are still rejected by the operation
+    CHECK_THROWS_AS(vm.Call("folded", { "hello"s }), InterpreterException);
+    CHECK_THROWS_AS(vm.Call("anded", { 5.0 }), InterpreterException);
+    CHECK(ToString(vm.Call("anded", { true })) == "False");
+
+    CompilerOptions options;
+    options.folding = false;
+    Parser q("examples/evaluator/ConstantFolding.ct", options);
+    INFO(q.Bytecode());
+    Profile unfolded;
+    VirtualMachine unfoldedVm(q.Bytecode(), Dispatch::Threaded, &unfolded);
+    CHECK(ToString(unfoldedVm.Call("area", { 2.0 })) == "12");
+    CHECK(unfolded.Count(OpCode::MultiplyNumber) == 3);
+    CHECK(ToString(unfoldedVm.Call("scale", { -0.0 })) == "-0");
+    CHECK(ToString(unfoldedVm.Call("describe", { true })) == "enabled");
+    CHECK(ToString(unfoldedVm.Call("describe", { false })) == "disabled");
+}
+
+TEST_CASE("Function inlining") {
+    Parser p("examples/evaluator/FunctionInlining.ct");
+    INFO(p.Bytecode());
+    Profile profile;
+    VirtualMachine vm(p.Bytecode(), Dispatch::Threaded, &profile);
+    CHECK(ToString(vm.Call("foo", { "B"s, 12.0 })) == "28");
+    CHECK(ToString(vm.Call("foo", { "D"s, 5.0 })) == "11");
+    CHECK(ToString(vm.Call("foo", { "A"s, -3.0 })) == "3");
+    CHECK(profile.Count(OpCode::Call) == 9);
+
+    const auto& inlined = p.Bytecode().inlined;
+    REQUIRE(inlined.size() == 4);
+    CHECK(inlined[0].callee == "IsValidColumn");
+    CHECK(inlined[0].caller == "foo");
+    CHECK(inlined[1].callee == "Clamp");
+    CHECK(inlined[2].callee == "Clamp");
+    CHECK(inlined[3].callee == "Reset");
+    CHECK(std::none_of(inlined.begin(), inlined.end(), [](const InlinedCall& call) { return call.callee == "Factorial"; }));
+
+    CompilerOptions options;
+    options.inlineBudget = 0;
+    Parser q("examples/evaluator/FunctionInlining.ct", options);
+    INFO(q.Bytecode());
+    Profile calls;
+    VirtualMachine callsVm(q.Bytecode(), Dispatch::Threaded, &calls);
+    CHECK(ToString(callsVm.Call("foo", { "B"s, 12.0 })) == "28");
+    CHECK(ToString(callsVm.Call("foo", { "D"s, 5.0 })) == "11");
+    CHECK(ToString(callsVm.Call("foo", { "A"s, -3.0 })) == "3");
+    CHECK(calls.Count(OpCode::Call) == 19);
+    CHECK(q.Bytecode().inlined.empty());
+}
+
+TEST_CASE("Loop invariants") {
+    Parser p("examples/evaluator/LoopInvariants.ct");
+    INFO(p.Bytecode());
+    Profile profile;
+    VirtualMachine vm(p.Bytecode(), Dispatch::Threaded, &profile);
+    CHECK(ToString(vm.Call("count", { 2.0 })) == "7");
+    CHECK(profile.Count(OpCode::LoadFieldChain) == 3);
+    CHECK(ToString(vm.Call("count", { 0.0 })) == "0");
+    CHECK(profile.Count(OpCode::LoadFieldChain) == 3);
+    CHECK(ToString(vm.Call("sum", { 2.0 })) == "6");
+    CHECK(ToString(vm.Call("sum", { 0.0 })) == "0");
+    CHECK(ToString(vm.Call("move", { 3.0 })) == "3");
+
+    // Invariants of loops that never run are not evaluated
+    CHECK(ToString(vm.Call("guarded", { 0.0, "a"s })) == "0");
+    CHECK_THROWS_AS(vm.Call("guarded", { 1.0, "a"s }), InterpreterException);
+
+    CompilerOptions options;
+    options.hoisting = false;
+    Parser q("examples/evaluator/LoopInvariants.ct", options);
+    INFO(q.Bytecode());
+    Profile unhoisted;
+    VirtualMachine unhoistedVm(q.Bytecode(), Dispatch::Threaded, &unhoisted);
+    CHECK(ToString(unhoistedVm.Call("count", { 2.0 })) == "7");
+    CHECK(unhoisted.Count(OpCode::LoadFieldChain) == 4);
+    CHECK(ToString(unhoistedVm.Call("sum", { 2.0 })) == "6");
+    CHECK(ToString(unhoistedVm.Call("move", { 3.0 })) == "3");
+}
+
+TEST_CASE("Dead code elimination") {
+    CompilerOptions options;
+    options.entries = { "foo" };
+    Parser p("examples/evaluator/DeadCode.ct", options);
+    INFO(p.Tree());
+    INFO(p.Bytecode());
+    CHECK(ToString(p.Evaluate("foo", { 2.0 })) == "3");
+    CHECK(ToString(p.Evaluate("foo", { -3.0 })) == "2");
+
+    const auto& program = p.Bytecode();
+    CHECK(program.functions.size() == 3);
+    CHECK(program.names.count("Distance") == 1);
+    CHECK(program.names.count("Sign") == 1);
+    CHECK(program.names.count("Report") == 0);
+    CHECK(program.names.count("WriteLine") == 0);
+    CHECK_THROWS_AS(p.Evaluate("Report", { 1.0 }), UndefinedIdentifierException);
+    CHECK(p.Tree().Root().definitions.size() == 4);
+
+    // Statements after a return are dropped even when all definitions are kept
+    Parser q("examples/evaluator/DeadCode.ct");
+    INFO(q.Bytecode());
+    CHECK(ToString(q.Evaluate("foo", { 2.0 })) == "3");
+    CHECK(q.Bytecode().names.count("Report") == 1);
+    CHECK(std::none_of(q.Bytecode().GetFunction("Sign").code.begin(), q.Bytecode().GetFunction("Sign").code.end(), [](const Instruction& instruction) {
+        return instruction.op == OpCode::CallExternal;
+    }));
+}
+
+TEST_CASE("Tail calls") {
+    for (unsigned jitThreshold : { 0u, 1u }) {
+        CompilerOptions options;
+        options.jitThreshold = jitThreshold;
+        Parser p("examples/evaluator/TailCall.ct", options);
+        INFO(p.Bytecode());
+        CHECK(ToString(p.Evaluate("Sum", { 4.0, 0.0 })) == "10");
+        CHECK(ToString(p.Evaluate("Sum", { 100000.0, 0.0 })) == "5.00005e+09");
+        CHECK(ToString(p.Evaluate("Triangle", { 100000.0 })) == "5.00005e+09");
+        CHECK(p.Bytecode().inlined.empty());
+        CHECK(std::get<std::string>(p.Evaluate("Count", { 20000.0, ""s })).size() == 20000);
+    }
+
+    CompilerOptions options;
+    options.tailCalls = false;
+    Parser q("examples/evaluator/TailCall.ct", options);
+    INFO(q.Bytecode());
+    Profile profile;
+    CHECK(ToString(VirtualMachine(q.Bytecode(), Dispatch::Threaded, &profile).Call("Sum", { 4.0, 0.0 })) == "10");
+    CHECK(profile.Count(OpCode::Call) == 4);
+    CHECK(profile.Count(OpCode::TailCall) == 0);
+}
+
+TEST_CASE("Call depth") {
+    for (unsigned jitThreshold : { 0u, 1u }) {
+        CompilerOptions options;
+        options.jitThreshold = jitThreshold;
+        options.inlineBudget = 0;
+        Parser p("examples/evaluator/DeepRecursion.ct", options);
+        INFO(p.Bytecode());
+        CHECK(ToString(p.Evaluate("Depth", { 50000.0 })) == "50000");
+        CHECK(std::get<std::string>(p.Evaluate("Dots", { 50000.0 })).size() == 50000);
+        // Generators called from scripts nest on the native stack
+        CHECK(ToString(p.Evaluate("Nested", { 100.0 })) == ToString(Value(Array(std::vector<Value>{ 100.0 }))));
+        CHECK_THROWS_AS(p.Evaluate("Nested", { 200000.0 }), InterpreterException);
+    }
+
+    CompilerOptions options;
+    options.maxDepth = 100;
+    Parser p("examples/evaluator/DeepRecursion.ct", options);
+    CHECK(ToString(p.Evaluate("Depth", { 99.0 })) == "99");
+    CHECK_THROWS_AS(p.Evaluate("Depth", { 100.0 }), InterpreterException);
+    CHECK_THROWS_AS(p.Evaluate("Dots", { 1000.0 }), InterpreterException);
+    CHECK(ToString(p.Evaluate("Depth", { 10.0 })) == "10");
+}
+
+TEST_CASE("Memoization") {
+    for (unsigned jitThreshold : { 0u, 1u }) {
+        CompilerOptions options;
+        options.jitThreshold = jitThreshold;
+        options.memoSize = 100;
+        Parser p("examples/evaluator/Memoization.ct", options);
+        INFO(p.Bytecode());
+        CHECK(ToString(p.Evaluate("Fibonacci", { 60.0 })) == "1.54801e+12");
+        CHECK(p.Bytecode().GetMemo("Fibonacci").Misses() == 61);
+        CHECK(p.Bytecode().GetMemo("Fibonacci").Hits() == 58);
+        CHECK(p.Bytecode().GetMemo("Fibonacci").Size() == 61);
+        CHECK(ToString(p.Evaluate("Fibonacci", { 60.0 })) == "1.54801e+12");
+        CHECK(p.Bytecode().GetMemo("Fibonacci").Hits() == 59);
+
+        CHECK(ToString(p.Evaluate("Greeting", { "World"s })) == "Hello World");
+        CHECK(ToString(p.Evaluate("Greeting", { "World"s })) == "Hello World");
+        CHECK(p.Bytecode().GetMemo("Greeting").Hits() == 1);
+        CHECK_THROWS_AS(p.Bytecode().GetMemo("Logged"), InterpreterException);
+        CHECK_THROWS_AS(p.Bytecode().GetMemo("Twice"), InterpreterException);
+
+        // Results of calls in tail position are remembered too
+        Parser r("examples/evaluator/Memoization.ct", options);
+        CHECK(ToString(r.Evaluate("Wrapped", { 30.0 })) == "832040");
+        CHECK(r.Bytecode().GetMemo("Fibonacci").Size() == 31);
+    }
+
+    CompilerOptions options;
+    options.memoSize = 8;
+    Parser p("examples/evaluator/Memoization.ct", options);
+    CHECK(ToString(p.Evaluate("Fibonacci", { 20.0 })) == "6765");
+    CHECK(p.Bytecode().GetMemo("Fibonacci").Size() == 8);
+    CHECK(p.Bytecode().GetMemo("Fibonacci").Evictions() > 0);
+
+    Parser q("examples/evaluator/Memoization.ct");
+    CHECK_THROWS_AS(q.Bytecode().GetMemo("Fibonacci"), InterpreterException);
+}
+
+TEST_CASE("Standard library") {
+    for (unsigned jitThreshold : { 0u, 1u }) {
+        CompilerOptions options;
+        options.jitThreshold = jitThreshold;
+        Parser p("examples/evaluator/Library.ct", options);
+        INFO(p.Bytecode());
+        CHECK(ToString(p.Evaluate("Words", { "a quick fox"s })) == "a,quick,fox");
+        CHECK(ToString(p.Evaluate("Prefix", { "interpreter"s, 5.0 })) == "inter");
+        CHECK(ToString(p.Evaluate("Prefix", { "tree"s, 10.0 })) == "tree");
+        CHECK(ToString(p.Evaluate("Position", { "interpreter"s, "pre"s })) == "5");
+        CHECK(ToString(p.Evaluate("Position", { "interpreter"s, "x"s })) == "-1");
+        CHECK(ToString(p.Evaluate("Size", { "four"s })) == "4");
+        CHECK(ToString(p.Evaluate("Hypotenuse", { 3.0, 4.0 })) == "5");
+        CHECK(ToString(p.Evaluate("Clamp", { 7.8 })) == "7");
+        CHECK(ToString(p.Evaluate("Clamp", { 12.0 })) == "10");
+        CHECK(ToString(p.Evaluate("Clamp", { -3.5 })) == "0");
+        CHECK(ToString(p.Evaluate("Price", { 2.5 })) == "2.50 EUR");
+    }
+}
+
+TEST_CASE("Library names") {
+    for (bool lazyParsing : { false, true }) {
+        CompilerOptions options;
+        options.lazyParsing = lazyParsing;
+        Parser p("examples/evaluator/LibraryNames.ct", options);
+        INFO(p.Bytecode());
+        CHECK(ToString(p.Evaluate("Length", { 3.0, 4.0 })) == "5");
+        CHECK(ToString(p.Evaluate("Max", { 1.0, 7.0, 3.0 })) == "7");
+        CHECK(ToString(p.Evaluate("Longest", { 6.0, 8.0 })) == "10");
+    }
+}
+
+TEST_CASE("String literal operands") {
+    for (const auto& [argument, expected] : { std::pair{ "World"s, "World!" }, { "Tree"s, "Hello Tree" }, { ""s, "Nobody" } }) {
+        Parser p("examples/evaluator/StringLiterals.ct");
+        INFO(p.Bytecode());
+        Profile profile;
+        CHECK(ToString(VirtualMachine(p.Bytecode(), Dispatch::Threaded, &profile).Call("Greeting", { argument })) == expected);
+        CHECK(profile.Count(OpCode::EqualConstant) == 1);
+        CHECK(profile.Count(OpCode::LoadConstant) == (argument == "World" ? 0 : 1));
+    }
+}
+
+TEST_CASE("String concatenation") {
+    Parser p("examples/evaluator/StringConcatenation.ct");
+    INFO(p.Bytecode());
+    CHECK(ToString(p.Evaluate("foo", { 100000.0 })) == "200001");
+    CHECK(ToString(p.Evaluate("Pieces", { 3.0 })) == "xxxxxxxxxxxxxx");
+}
+
+TEST_CASE("Number arrays") {
+    Parser p("examples/evaluator/NumberArrays.ct");
+    INFO(p.Bytecode());
+    CHECK(ToString(p.Evaluate("Statistics")) == "81");
+    CHECK(ToString(p.Evaluate("Doubled")) == "3 5 6");
+    CHECK_THROWS_AS(p.Evaluate("Words"), InterpreterException);
+
+    const auto& code = p.Bytecode().GetFunction("Statistics").code;
+    CHECK(std::count_if(code.begin(), code.end(), [](const Instruction& instruction) { return instruction.op == OpCode::NewArray && instruction.d; }) == 2);
+
+    std::vector<double> numbers(1001);
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        numbers[i] = static_cast<double>(i);
+    }
+    Value array = Array(std::move(numbers));
+    CHECK(Library::Total(array) == 500500);
+    CHECK(Library::Dot(array, array) == 333833500);
+    CHECK(Library::Minimum(Library::Scaled(array, -1)) == -1000);
+    CHECK(Library::Maximum(array) == 1000);
+}
+
+TEST_CASE("Array indexing") {
+    Parser p("examples/evaluator/ArrayIndexing.ct");
+    INFO(p.Bytecode());
+    CHECK(ToString(p.Evaluate("Squares", { 5.0 })) == "28");
+    CHECK(ToString(p.Evaluate("Squares", { 100000.0 })) == "9.9999e+09");
+    CHECK(ToString(p.Evaluate("Mixed")) == "one 2 three");
+    CHECK(ToString(p.Evaluate("Copied")) == "3");
+    CHECK_THROWS_AS(p.Evaluate("OutOfBounds"), InterpreterException);
+    CHECK_THROWS_AS(p.Evaluate("Fraction"), InterpreterException);
+
+    const auto& code = p.Bytecode().GetFunction("Squares").code;
+    CHECK(std::count_if(code.begin(), code.end(), [](const Instruction& instruction) { return instruction.op == OpCode::Push; }) == 1);
+    CHECK(std::count_if(code.begin(), code.end(), [](const Instruction& instruction) { return instruction.op == OpCode::LoadIndex; }) == 2);
+}
+
+TEST_CASE("Parallel for") {
+    Parser p("examples/evaluator/ParallelFor.ct");
+    INFO(p.Bytecode());
+    CHECK(ToString(p.Evaluate("Squares", { 100.0 })) == "328450");
+    CHECK(ToString(p.Evaluate("Accumulated", { 100.0 })) == "5050");
+    CHECK(ToString(p.Evaluate("Doubled", { 3.0 })) == "2 4 6");
+    CHECK_THROWS_AS(p.Evaluate("Doubled", { 4.0 }), InterpreterException);
+
+    // Loop writing a variable of the function runs sequentially
+    auto parallel = [&](const std::string& name) {
+        const auto& code = p.Bytecode().GetFunction(name).code;
+        return std::any_of(code.begin(), code.end(), [](const Instruction& instruction) { return instruction.op == OpCode::ParallelFor; });
+    };
+    CHECK(parallel("Squares"));
+    CHECK(parallel("Doubled"));
+    CHECK(!parallel("Accumulated"));
+    CHECK(!parallel("Reset"));
+    CHECK(ToString(p.Evaluate("Reset", { 100000.0 })) == "100000");
+
+    CompilerOptions options;
+    options.parallel = false;
+    Parser q("examples/evaluator/ParallelFor.ct", options);
+    CHECK(ToString(q.Evaluate("Squares", { 100.0 })) == "328450");
+}
+
+TEST_CASE("Spawn and await") {
+    Parser p("examples/evaluator/Tasks.ct");
+    INFO(p.Bytecode());
+    CHECK(ToString(p.Evaluate("Overlapped", { 100.0 })) == "25150");
+    CHECK(ToString(p.Evaluate("Nested", { 10.0 })) == "265");
+    CHECK(ToString(p.Evaluate("Greetings", {})) == "Hello Ann, Hello Bob");
+
+    // Errors of a task are raised where it is awaited or, when no one awaits it, by the call
+    CHECK_THROWS_AS(p.Evaluate("Awaited", {}), InterpreterException);
+    CHECK_THROWS_AS(p.Evaluate("Forgotten", {}), InterpreterException);
+    CHECK_THROWS_AS(p.Evaluate("Unknown", {}), InterpreterException);
+}
+
+TEST_CASE("Generators") {
+    Parser p("examples/evaluator/Generators.ct");
+    INFO(p.Bytecode());
+
+    std::string numbers;
+    for (const Value& value : p.Generate("Numbers", { 4.0 })) {
+        numbers += ToString(value) + " ";
+    }
+    CHECK(numbers == "0 1 2 3 ");
+
+    // Values are computed only once they are asked for
+    auto fibonacci = p.Generate("Fibonacci");
+    Value value;
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(fibonacci.Next(value));
+    }
+    CHECK(ToString(value) == "34");
+
+    auto words = p.Generate("Words", { true });
+    CHECK((words.Next(value) && ToString(value) == "first"));
+    CHECK(!words.Next(value));
+    CHECK(!words.Next(value));
+
+    // Calls from scripts and from the host collect all values into an array
+    CHECK(ToString(p.Evaluate("Collected", { 3.0 })) == "0 1 2");
+    CHECK(ToString(p.Evaluate("Sentence", {})) == "first second");
+
+    auto broken = p.Generate("Broken");
+    CHECK(broken.Next(value));
+    CHECK_THROWS_AS(broken.Next(value), InterpreterException);
+    CHECK(!broken.Next(value));
+    CHECK_THROWS_AS(p.Generate("Collected", { 1.0 }), InterpreterException);
+}
+
 } // namespace EvaluatorTests
@@ -8,6 +8,28 @@ using namespace Interpreter;
 
 namespace ExternalFunctionsTests {
 
+double Scale(double value, int factor) {
+    return value * factor;
+}
+
+bool IsLong(const std::string& text) {
+    return text.size() > 5;
+}
+
+std::string Describe(const std::string& name, double value, bool isLong) {
+    return name + " " + ToString(value) + (isLong ? " long" : " short");
+}
+
+std::vector<Value> recorded;
+
+void Record(Value value) {
+    recorded.push_back(std::move(value));
+}
+
+void Show(const Value& value) {
+    recorded.push_back(value);
+}
+
 TEST_CASE("Write") {
     std::ostringstream oss;
     std::streambuf* buffer = std::cout.rdbuf();
@@ -88,4 +110,90 @@ TEST_CASE("ReadNumber") {
     CHECK(ret == 1.5);
 }
 
+TEST_CASE("Buffered output") {
+    std::string expected;
+    for (int i = 0; i < 1000; ++i) {
+        expected += std::to_string(i) + " line\n";
+    }
+
+    Parser p("examples/externalfunctions/WriteMany.ct");
+    for (size_t capacity : { size_t(0), size_t(100), size_t(1) << 16 }) {
+        std::ostringstream oss;
+        p.Sink().Redirect(oss);
+        p.Sink().Capacity(capacity);
+        p.Evaluate("foo", { 1000.0 });
+        CHECK(oss.str() == expected);
+
+        {
+            Output::Scope scope(p.Sink());
+            Write("pending"s);
+            CHECK(oss.str().size() == expected.size() + (capacity ? 0 : 7));
+            p.Sink().Flush();
+            CHECK(oss.str() == expected + "pending");
+        }
+    }
+
+    // Parsers write to outputs of their own, outside of evaluations writes are not buffered
+    std::ostringstream other;
+    Parser q("examples/externalfunctions/WriteMany.ct");
+    q.Sink().Redirect(other);
+    q.Evaluate("foo", { 2.0 });
+    CHECK(other.str() == "0 line\n1 line\n");
+    CHECK(&Output::Current() != &q.Sink());
+}
+
+TEST_CASE("External functions see numbers as doubles") {
+    ExternalDefinitions externals;
+    externals.push_back({ "func Show(var value): void", &Show });
+    for (unsigned jitThreshold : { 0u, 1u }) {
+        CompilerOptions options;
+        options.jitThreshold = jitThreshold;
+        Parser p("examples/externalfunctions/Shown.ct", options, externals);
+        INFO(p.Bytecode());
+        recorded.clear();
+        p.Evaluate("foo", { 3.0 });
+        p.Evaluate("foo", { 3.0 });
+        REQUIRE(recorded.size() == 8);
+        for (const auto& value : recorded) {
+            CHECK(std::holds_alternative<double>(value));
+        }
+    }
+}
+
+TEST_CASE("Bound functions") {
+    ExternalDefinitions externals;
+    externals.Bind("Scale", &Scale).Bind("IsLong", &IsLong).Bind("Describe", &Describe).Bind("Record", &Record).Bind("Show", &Show);
+    REQUIRE(externals.size() == 5);
+    CHECK(externals[0].signature == "func Scale(var a0: number, var a1: number): number");
+    CHECK(externals[1].signature == "func IsLong(var a0: string): bool");
+    CHECK(externals[2].signature == "func Describe(var a0: string, var a1: number, var a2: bool): string");
+    CHECK(externals[3].signature == "func Record(var a0): void");
+
+    for (unsigned jitThreshold : { 0u, 1u }) {
+        CompilerOptions options;
+        options.jitThreshold = jitThreshold;
+        Parser p("examples/externalfunctions/Bound.ct", options, externals);
+        INFO(p.Bytecode());
+        recorded.clear();
+        CHECK(ToString(p.Evaluate("foo", { "interpreter"s })) == "interpreter 3 long");
+        CHECK(ToString(p.Evaluate("foo", { "tree"s })) == "tree 3 short");
+        REQUIRE(recorded.size() == 4);
+        CHECK(std::get<double>(recorded[0]) == 12);
+        CHECK(std::get<std::string>(recorded[1]) == "interpreter");
+
+        // Integer parameters accept only integral numbers they can hold
+        CHECK(ToString(p.Evaluate("scaled", { 2.0 })) == "3");
+        CHECK_THROWS_AS(p.Evaluate("scaled", { 2.5 }), InterpreterException);
+        CHECK_THROWS_AS(p.Evaluate("scaled", { 1e10 }), InterpreterException);
+        CHECK_THROWS_AS(p.Evaluate("scaled", { std::nan("") }), InterpreterException);
+
+        // Untyped parameters see numbers as doubles, also within arrays
+        recorded.clear();
+        p.Evaluate("shown", { 7.0 });
+        REQUIRE(recorded.size() == 2);
+        CHECK(std::holds_alternative<double>(recorded[0]));
+        CHECK(std::holds_alternative<double>(recorded[1]));
+    }
+}
+
 } // namespace ExternalFunctionsTests
@@ -1,6 +1,9 @@
 #include "catch.hpp"
 
+#include <algorithm>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "../Interpreter"
 
@@ -10,7 +13,9 @@ using namespace Interpreter;
 namespace {
 
 void CompareTree(const std::string& fileName) {
-    Parser p("examples/parser/" + fileName + ".ct");
+    CompilerOptions options;
+    options.folding = false;
+    Parser p("examples/parser/" + fileName + ".ct", options);
     ostringstream actual;
     actual << p.Tree();
 
@@ -21,8 +26,8 @@ void CompareTree(const std::string& fileName) {
     CHECK(actual.str() == expected.str());
 }
 
-void TryCreateParser(const std::string& name) {
-    Parser p("examples/" + name);
+void TryCreateParser(const std::string& name, const CompilerOptions& options = {}) {
+    Parser p("examples/" + name, options);
 }
 
 } // namespace
@@ -93,8 +98,77 @@ TEST_CASE("Wrong parser files") {
     CHECK_THROWS_WITH(TryCreateParser("parser/WrongFuncBlock.ct"),
         "Failed to parse [Bracket '}' on line 3]. Expected Bracket.");
     CHECK_THROWS_WITH(TryCreateParser("parser/WrongStatement.ct"),
-        "Failed to parse [Func 'func' on line 3]. Expected one of following { Return, For, If, While, Do, Unary Operator, Binary Operator, Identifier, Var, New, Bracket, True, False, Number, String, }."
+        "Failed to parse [Func 'func' on line 3]. Expected one of following { Return, For, Parallel, If, While, Do, Unary Operator, Binary Operator, Identifier, Var, New, Bracket, True, False, Number, String, }."
     );
 }
 
+TEST_CASE("Parallel parsing") {
+    CompilerOptions options;
+    options.parallelParsing = true;
+
+    Parser p("examples/evaluator/Tasks.ct", options);
+    CHECK(ToString(p.Evaluate("Overlapped", { 100.0 })) == "25150");
+    CHECK(ToString(p.Evaluate("Greetings", {})) == "Hello Ann, Hello Bob");
+    Parser q("examples/evaluator/Object.ct", options);
+    Parser r("examples/evaluator/Object.ct");
+    CHECK(q.Tree().Root().definitions.size() == r.Tree().Root().definitions.size());
+
+    // Errors in bodies are the same as when parsed in sequence
+    CHECK_THROWS_WITH(TryCreateParser("parser/WrongFuncBlock.ct", options),
+        "Failed to parse [Bracket '}' on line 3]. Expected Bracket.");
+    CHECK_THROWS_WITH(TryCreateParser("parser/WrongStatement.ct", options),
+        "Failed to parse [Func 'func' on line 3]. Expected one of following { Return, For, Parallel, If, While, Do, Unary Operator, Binary Operator, Identifier, Var, New, Bracket, True, False, Number, String, }."
+    );
+    CHECK_THROWS_WITH(TryCreateParser("typecheck/WrongArguments.ct", options),
+        "Type mismatch error on line 5. Expected \"4:string\" got \"5:number\".");
+    CHECK_THROWS_WITH(TryCreateParser("typecheck/WrongMultipleReturn.ct", options),
+        "Type mismatch error on line 5 caused by wrong return type. Expected \"5:number\" got \"4:string\".");
+}
+
+TEST_CASE("Lazy parsing") {
+    CompilerOptions options;
+    options.lazyParsing = true;
+
+    // Broken bodies are not parsed until their function is called
+    Parser p("examples/evaluator/LazyParsing.ct", options);
+    CHECK_FALSE(p.Tree().Root().GetFunction("Factorial").block);
+    CHECK(ToString(p.Evaluate("Factorial", { 5.0 })) == "120");
+    CHECK(p.Tree().Root().GetFunction("Factorial").block);
+    CHECK_FALSE(p.Tree().Root().GetFunction("Run").block);
+    CHECK(ToString(p.Evaluate("Run", { 4.0 })) == "19");
+    CHECK_FALSE(p.Tree().Root().GetFunction("Unused").block);
+
+    CHECK_THROWS_AS(p.Evaluate("Unused", { 1.0 }), InterpreterException);
+    CHECK_THROWS_AS(p.Evaluate("Mistyped"), InterpreterException);
+    CHECK_THROWS_AS(p.Evaluate("Unused", { 1.0 }), InterpreterException);
+
+    // Calls from several threads load a body once
+    Parser q("examples/evaluator/LazyParsing.ct", options);
+    std::vector<std::thread> threads;
+    std::vector<std::string> results(8);
+    for (size_t i = 0; i < results.size(); ++i) {
+        threads.emplace_back([&, i]() { results[i] = ToString(q.Evaluate("Run", { 4.0 })); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(std::all_of(results.begin(), results.end(), [](const std::string& result) { return result == "19"; }));
+}
+
+TEST_CASE("Forward references") {
+    // Bodies see the same definitions whether they are parsed in place, in parallel or lazily
+    CompilerOptions parallel;
+    parallel.parallelParsing = true;
+    CompilerOptions lazy;
+    lazy.lazyParsing = true;
+
+    CHECK_THROWS_WITH(TryCreateParser("parser/WrongForwardCall.ct"),
+        "An exception occured on line 2. Message: Found undefined identifier Helper.");
+    CHECK_THROWS_WITH(TryCreateParser("parser/WrongForwardCall.ct", parallel),
+        "An exception occured on line 2. Message: Found undefined identifier Helper.");
+    Parser p("examples/parser/WrongForwardCall.ct", lazy);
+    CHECK(ToString(p.Evaluate("Helper", { 1.0 })) == "2");
+    CHECK_THROWS_AS(p.Evaluate("Caller", { 1.0 }), InterpreterException);
+}
+
 } // namespace ParserTests
@@ -0,0 +1,55 @@
+#include "catch.hpp"
+
+#include "../Interpreter"
+
+using namespace std;
+using namespace Interpreter;
+
+extern "C" void InterpreterFunctions(ExternalDefinitions& definitions);
+
+namespace TranspilerTests {
+
+ExternalDefinitions Transpiled() {
+    ExternalDefinitions definitions;
+    InterpreterFunctions(definitions);
+    return definitions;
+}
+
+TEST_CASE("Transpiled functions") {
+    Parser original("examples/transpiler/Functions.ct");
+    Parser transpiled("examples/evaluator/Empty.ct", {}, Transpiled());
+    INFO(original.Tree());
+
+    SECTION("Registered signatures") {
+        auto definitions = Transpiled();
+        REQUIRE(definitions.size() == 7);
+        CHECK(definitions[0].signature == "func Fibonacci(var n: number): number");
+        CHECK(definitions[3].signature == "func Greeting(var name: string, var excited: bool): string");
+        CHECK(definitions[4].signature == "func Move(var point, var dx)");
+    }
+
+    SECTION("Same results as interpreted") {
+        const vector<pair<string, list<Value>>> calls = {
+            { "Fibonacci", { 15.0 } },
+            { "Sum", { 1.0, 10.0 } },
+            { "Sum", { 10.0, -3.0 } },
+            { "Halvings", { 100.0 } },
+            { "Greeting", { "World"s, true } },
+            { "Greeting", { "World"s, false } },
+            { "Walk", { 4.0 } },
+            { "Mixed", { 1.0, 2.0 } },
+            { "Mixed", { "a"s, "b"s } },
+        };
+        for (const auto& [function, arguments] : calls) {
+            INFO(function);
+            CHECK(ToString(transpiled.Evaluate(function, arguments)) == ToString(original.Evaluate(function, arguments)));
+        }
+    }
+
+    SECTION("Values not matching static types") {
+        CHECK_THROWS_AS(transpiled.Evaluate("Fibonacci", { "15"s }), InterpreterException);
+        CHECK_THROWS_AS(transpiled.Evaluate("Mixed", { 1.0, true }), std::exception);
+    }
+}
+
+} // namespace TranspilerTests